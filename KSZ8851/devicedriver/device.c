@@ -77,6 +77,9 @@ static const char * DEVICE_TASK_NAME = DEVICE_NAME " unit task";
 
 static ULONG AbortRequestAndRemove(struct MinList *, struct IOSana2Req *,struct DeviceDriver *,struct SignalSemaphore * lock);
 static void  AbortReqList(struct MinList *minlist,struct DeviceDriver * EtherDevice);
+static struct MinList * getReadQueue(struct BufferManagement * bm, ULONG packetType, BOOL claimSlot);
+static void abortReadQueues(struct BufferManagement * bm, struct DeviceDriver * EtherDevice);
+static void discardParkedFrames(struct DeviceDriverUnit * etherUnit, struct BufferManagement * bm);
 static BOOL ReadConfig( struct DeviceDriver *, struct DeviceDriverUnit *, const char * );
 static void DevProcEntry(void);
 static BOOL checkStackSpace(int minStackSize);
@@ -101,6 +104,20 @@ void printEthernetAddress(unsigned char * addr);
 #define ETHERNET_MTU 1500
 #define ETHER_PACKET_HEAD_SIZE 14
 
+//Slot of a packet type in eu_Track
+#define TRACK_TYPE_SLOT(type) ((UWORD)((type) ^ ((type) >> 8)) % TRACK_TYPE_SLOTS)
+
+//Unit of a callback of the lowleveldriver (NetInterface.userData, set in DevCmdOnline)
+#define UNIT_OF(interface) ((struct DeviceDriverUnit *)(interface)->userData)
+
+//Openers onPktHeader remembers for bs_EmptyQueueDrops (with more the packet is copied, onPktReceived counts them)
+#define RX_STARVING_MAX 4
+
+//Events of countTypeStats
+#define TYPE_STAT_SENT     0
+#define TYPE_STAT_RECEIVED 1
+#define TYPE_STAT_DROPPED  2
+
 //This is for defining the API version to the PC side.
 const UWORD DevVersion  = (UWORD)DEVICE_VERSION;
 const UWORD DevRevision = (UWORD)DEVICE_REVISION;
@@ -112,6 +129,8 @@ const char DevIdString[] = VERSION_STRING;
 
 struct ExecBase * SysBase  = NULL;
 struct DeviceDriver * globEtherDevice = NULL;
+//Global statistics (S2_GETGLOBALSTATS). Counted without locks: the receive callbacks run one after the
+//other (NIC locked), the send path holds eu_TxLock. A 32 bit access is atomic on the 68k.
 struct Sana2DeviceStats GlobStat;
 
 //init and deinit auto-open-library of "libnix" which has to be handles by hand here.
@@ -127,6 +146,7 @@ VOID  ExpungeUnit(UBYTE unitNumber, struct DeviceDriver *etherDevice);
 struct DeviceDriverUnit *InitUnitProcess(ULONG,struct DeviceDriver * ETHERDevice);
 VOID DevCmdTrackType(STDETHERARGS);
 VOID DevCmdUnTrackType(STDETHERARGS);
+VOID DevCmdGetTypeStats(STDETHERARGS);
 VOID DevCmdConfigInterface(STDETHERARGS);
 VOID DevCmdReadPacket(STDETHERARGS);
 VOID DevCmdReadOrphan(STDETHERARGS);
@@ -144,7 +164,10 @@ VOID DevCmdGetSpecialStats(STDETHERARGS);
 VOID DevCmdNSDeviceQuery(STDETHERARGS);
 
 static void dumpMem(uint8_t * mem, int16_t len);
+static struct MCAF_Address * findMulticastAddress(const UBYTE * address);
 static void sendAllPackets(struct DeviceDriverUnit *etherUnit, struct DeviceDriver *etherDevice);
+static void onTxSpaceAvailable(NetInterface * interface);
+static void bottomHalf(REG(a1, struct DeviceDriverUnit * etherUnit));
 
 //############ Externe Variablen und Funktionen ################################
 
@@ -197,6 +220,7 @@ struct Library * DeviceInit(BPTR DeviceSegList, struct Library * DevBasePointer,
    // Device Semaphores
    InitSemaphore((APTR)&globEtherDevice->ed_DeviceLock);
    InitSemaphore((APTR)&globEtherDevice->ed_MCAF_Lock);
+   NewList((struct List *)&globEtherDevice->ed_MCAF);
    
    DEBUGOUT((1, "DevInit end, returning 0x%lx\n", globEtherDevice));
    return (struct Library *)globEtherDevice;
@@ -219,6 +243,7 @@ void DeviceOpen(struct IOSana2Req *ios2,
    struct DeviceDriverUnit *etherUnit;
    struct BufferManagement *bm;
    BOOL success = FALSE; 
+   int i;
 
    /*
    DEBUGOUT((VERBOSE_DEVICE, "Parameter Test: '1' == %ld (16 bit)\n", (uint16_t) 1));
@@ -258,12 +283,9 @@ void DeviceOpen(struct IOSana2Req *ios2,
       }
 
       //open in promisc mode ? (only in conjunction with flag MINE!!!)
-      if (s2flags & SANA2OPF_PROM)
+      if ((s2flags & SANA2OPF_PROM) && !(s2flags & SANA2OPF_MINE))
       {
-         if (s2flags & SANA2OPF_MINE)
-            globEtherDevice->ed_Device.lib_Flags |= ETHERUF_PROMISC;
-         else
-            goto end;
+         goto end;
       }
 
       //Early access to the low level driver
@@ -278,6 +300,12 @@ void DeviceOpen(struct IOSana2Req *ios2,
          {
             etherUnit->eu_lowLevelDriver = lowLevelDriver;
 
+            //Promiscuous mode is a state of the unit (see isWantedMulticast)
+            if (s2flags & SANA2OPF_PROM)
+            {
+               etherUnit->eu_State |= ETHERUF_PROMISC;
+            }
+
             //PromMode setzen/löschen wenn Device schon online
             if (etherUnit->eu_State & ETHERUF_ONLINE)
             {
@@ -287,18 +315,23 @@ void DeviceOpen(struct IOSana2Req *ios2,
             /*
              * Get Memory for storing buffer management functions
              */
-            bm = AllocMem(sizeof(struct BufferManagement), MEMF_CLEAR | MEMF_PUBLIC);
+            bm = PoolAlloc(&etherUnit->eu_OpenerPool);
             if( bm )
             {
                struct TagItem *bufftag;
-               bzero(bm, sizeof(struct BufferManagement));
 
-               /* Init the list for CMD_READ requests */
+               /* Init the lists for CMD_READ requests */
                InitSemaphore((APTR) &bm->bm_RxQueueLock);
                NewList((struct List *) &bm->bm_RxQueue);
+               for (i = 0; i < BM_TYPE_SLOTS; i++) {
+                  NewList((struct List *) &bm->bm_TypeQueue[i]);
+               }
 
                //Add BM to the list of all BM's...
+               ObtainSemaphore((APTR) &etherUnit->eu_BuffMgmtLock);
                AddTail((struct List *)&etherUnit->eu_BuffMgmt,(struct Node *)bm);
+               ReleaseSemaphore((APTR) &etherUnit->eu_BuffMgmtLock);
+               bm->bm_Tag = BM_TAG_OPEN;
 
                const struct TagItem * tagItem = ios2->ios2_BufferManagement;
                if(tagItem)
@@ -436,7 +469,8 @@ BPTR DeviceClose(struct IOSana2Req *ios2, struct Library * DevBase)
       if (bm)
       {
          ObtainSemaphore((APTR) &bm->bm_RxQueueLock);
-         AbortReqList(&bm->bm_RxQueue, globEtherDevice);
+         bm->bm_Tag = 0;
+         abortReadQueues(bm, globEtherDevice);
          ReleaseSemaphore((APTR) &bm->bm_RxQueueLock);
 
          // Find the single buffer management from the caller and free it
@@ -448,7 +482,8 @@ BPTR DeviceClose(struct IOSana2Req *ios2, struct Library * DevBase)
             if (bm == ios2->ios2_BufferManagement)
             {
                Remove((struct Node *) bm);
-               FreeMem(bm, sizeof(struct BufferManagement));
+               discardParkedFrames(etherUnit, bm);
+               PoolFree(&etherUnit->eu_OpenerPool, bm);
                ios2->ios2_BufferManagement = NULL;
                break;
             }
@@ -461,7 +496,7 @@ BPTR DeviceClose(struct IOSana2Req *ios2, struct Library * DevBase)
       //Reset always exclusive, loopback or promiscue mode...
       globEtherDevice->ed_Device.lib_Flags &= ~ETHERUF_EXCLUSIVE;
       globEtherDevice->ed_Device.lib_Flags &= ~ETHERUF_LOOPBACK;
-      globEtherDevice->ed_Device.lib_Flags &= ~ETHERUF_PROMISC;
+      etherUnit->eu_State &= ~ETHERUF_PROMISC;
 
       /* Trash the io_Device and io_Unit fields so that any attempt to use this
        request will die immediately. */
@@ -598,7 +633,12 @@ ULONG DeviceAbortIO( struct IOSana2Req *ios2, struct Library * DevPointer)
          case CMD_READ:
          {
             struct BufferManagement *bm = ios2->ios2_BufferManagement;
-            result = AbortRequestAndRemove(&bm->bm_RxQueue, ios2, globEtherDevice, &bm->bm_RxQueueLock);
+            ObtainSemaphore(&bm->bm_RxQueueLock);
+            result = AbortRequestAndRemove(getReadQueue(bm, ios2->ios2_PacketType, FALSE), ios2, globEtherDevice,
+                  &bm->bm_RxQueueLock);
+            if (result == IOERR_ABORTED)
+               bm->bm_Stats.bs_ReadsPending--;
+            ReleaseSemaphore(&bm->bm_RxQueueLock);
             break;
          }
 
@@ -719,6 +759,52 @@ static void  AbortReqList(struct MinList *minlist,struct DeviceDriver * EtherDev
     }    
 }
 
+/**
+ * Returns the list of pending CMD_READ requests of an opener for the given packet type:
+ * the slot of the type or bm_RxQueue when the slot is owned by another type.
+ *
+ * @param bm
+ * @param packetType
+ * @param claimSlot TRUE: the type gets a free slot (the type keeps the slot as long as the opener exists)
+ * @return
+ */
+static struct MinList * getReadQueue(struct BufferManagement * bm, ULONG packetType, BOOL claimSlot)
+{
+   UWORD slot;
+
+   //IEEE 802.3: all requests share one slot
+   if (packetType <= 1500)
+      return &bm->bm_TypeQueue[0];
+
+   slot = 1 + (UWORD)((packetType ^ (packetType >> 8)) % (BM_TYPE_SLOTS - 1));
+   if (bm->bm_TypeQueueType[slot] == packetType)
+      return &bm->bm_TypeQueue[slot];
+
+   if (claimSlot && bm->bm_TypeQueueType[slot] == 0)
+   {
+      bm->bm_TypeQueueType[slot] = packetType;
+      return &bm->bm_TypeQueue[slot];
+   }
+
+   return &bm->bm_RxQueue;
+}
+
+/**
+ * Abort all pending CMD_READ requests of an opener. The bm_RxQueueLock must be held.
+ *
+ * @param bm
+ * @param EtherDevice
+ */
+static void abortReadQueues(struct BufferManagement * bm, struct DeviceDriver * EtherDevice)
+{
+   int slot;
+
+   AbortReqList(&bm->bm_RxQueue, EtherDevice);
+   for (slot = 0; slot < BM_TYPE_SLOTS; slot++)
+      AbortReqList(&bm->bm_TypeQueue[slot], EtherDevice);
+   bm->bm_Stats.bs_ReadsPending = 0;
+}
+
 /**
  * Flush device. All current IORequests are aborted...
  * Method can be invoked with iorequest == null.
@@ -739,8 +825,9 @@ VOID DevCmdFlush(STDETHERARGS)
    while (bm->bm_Node.mln_Succ)
    {
       ObtainSemaphore((APTR) &bm->bm_RxQueueLock);
-      AbortReqList(&bm->bm_RxQueue, globEtherDevice);
+      abortReadQueues(bm, globEtherDevice);
       ReleaseSemaphore((APTR) &bm->bm_RxQueueLock);
+      discardParkedFrames(etherUnit, bm);
       bm = (struct BufferManagement *) bm->bm_Node.mln_Succ;
    }
    ReleaseSemaphore((APTR)&etherUnit->eu_BuffMgmtLock);
@@ -807,7 +894,16 @@ struct DeviceDriverUnit *InitUnitProcess(ULONG s2unit, struct DeviceDriver *Ethe
                 NewList((struct List *)&etherUnit->eu_Events);
 
                 InitSemaphore((void *)&etherUnit->eu_TrackLock);
-                NewList((struct List *)&etherUnit->eu_Track);
+
+                InitSemaphore((void *)&etherUnit->eu_RxParkLock);
+
+                InitSemaphore((void *)&etherUnit->eu_TxLock);
+
+                etherUnit->eu_BottomHalf.is_Node.ln_Type = NT_INTERRUPT;
+                etherUnit->eu_BottomHalf.is_Node.ln_Pri  = 0;
+                etherUnit->eu_BottomHalf.is_Node.ln_Name = DEVICE_NAME ".bottomhalf";
+                etherUnit->eu_BottomHalf.is_Data         = etherUnit;
+                etherUnit->eu_BottomHalf.is_Code         = (VOID (*)())bottomHalf;
 
                 /* Start up the unit process (and wait for the reply) */
                 struct MsgPort * replyport = CreateMsgPort();
@@ -857,16 +953,76 @@ static BOOL ReadConfig( struct DeviceDriver *etherDevice, struct DeviceDriverUni
 {
     DEBUGOUT((VERBOSE_DEVICE, "ReadConfigFile: %s\n", sConfigFile));
 
+    NetInterface * lowLevelDriver = deviceUnit->eu_lowLevelDriver;
+
     RegistryInit( sConfigFile );
     {
        debugLevel = ReadKeyInt("DEBUGLEV" , false);
        ReadKeyMacAddress("MAC", deviceUnit->eu_StAddr, FALLBACK_MAC_ADDRESS);
+
+       //RX interrupt coalescing (default: one interrupt per frame)
+       lowLevelDriver->rxCoalesceFrames   = ReadKeyInt("RXINTFRAMES", 1);
+       lowLevelDriver->rxCoalesceBytes    = ReadKeyInt("RXINTBYTES", 0);
+       lowLevelDriver->rxCoalesceTime     = ReadKeyInt("RXINTTIME", 0);
+       lowLevelDriver->rxCoalesceAdaptive = ReadKeyInt("RXINTADAPTIVE", 0) != 0;
+
+       //RX polling under load (default: off). The poll timer is only opened when the unit goes online with a budget.
+       lowLevelDriver->rxPollBudget   = ReadKeyInt("RXPOLLBUDGET", 0);
+       lowLevelDriver->rxPollInterval = ReadKeyInt("RXPOLLINTERVAL", 0);
+
+       //Queue TX frames by the NIC when written (TXQCR_AETFE) instead of a manual enqueue
+       lowLevelDriver->txAutoEnqueue = ReadKeyInt("TXAUTOENQUEUE", 0) != 0;
+
+       //Process the NIC events in a software interrupt right after the NIC interrupt instead of the unit process
+       lowLevelDriver->bottomHalf = ReadKeyInt("BOTTOMHALF", 0) ? &deviceUnit->eu_BottomHalf : NULL;
+
+       //Let the NIC generate and check the IP/TCP/UDP/ICMP checksums
+       lowLevelDriver->checksumOffload = ReadKeyInt("CHECKSUMOFFLOAD", 0) != 0;
+
+       //Send the packets in the task of the stack or in the unit process
+       deviceUnit->eu_TxMode = ReadKeyInt("TXMODE", TX_MODE_CALLER) == TX_MODE_UNIT ? TX_MODE_UNIT : TX_MODE_CALLER;
+
+       //Park pool for packets of openers without a pending read (the slots are only allocated at unit start)
+       if (!deviceUnit->eu_RxPark) {
+          deviceUnit->eu_RxParkSlots = ReadKeyInt("RXPARKSLOTS", 16);
+       }
+       deviceUnit->eu_RxParkPerOpener = ReadKeyInt("RXPARKPEROPENER", 8);
+
+       //Objects of the pools (only used at unit start)
+       if (!deviceUnit->eu_OpenerPool.fp_Memory) {
+          deviceUnit->eu_OpenerPool.fp_Objects    = ReadKeyInt("POOLOPENERS", 8);
+          deviceUnit->eu_TrackPool.fp_Objects     = ReadKeyInt("POOLTRACKTYPES", 16);
+          deviceUnit->eu_MulticastPool.fp_Objects = ReadKeyInt("POOLMULTICAST", 32);
+       }
     }
     RegistryDestroy();
 
+    //Only the unit process sending the packets needs a signal for every queued write request
+    deviceUnit->eu_Tx->mp_Flags = deviceUnit->eu_TxMode == TX_MODE_UNIT ? PA_SIGNAL : PA_IGNORE;
+
+    //Already online? Otherwise the settings are used when the hardware is initialized.
+    if (deviceUnit->eu_State & ETHERUF_ONLINE) {
+       lowLevelDriver->updateRxCoalescing(lowLevelDriver);
+       lowLevelDriver->updateChecksumOffload(lowLevelDriver);
+    }
+
     DEBUGOUT((VERBOSE_DEVICE,"\n\n ##### " DEVICE_NAME " Device #####\n"));
     DEBUGOUT((VERBOSE_DEVICE,"%s\n", DevIdString));
     DEBUGOUT((VERBOSE_DEVICE,"DebugLev= %ld\n", (LONG)debugLevel));
+    DEBUGOUT((VERBOSE_DEVICE,"RX coalescing: frames=%ld bytes=%ld time=%ldus adaptive=%ld\n",
+          (LONG)lowLevelDriver->rxCoalesceFrames, (LONG)lowLevelDriver->rxCoalesceBytes,
+          (LONG)lowLevelDriver->rxCoalesceTime, (LONG)lowLevelDriver->rxCoalesceAdaptive));
+    DEBUGOUT((VERBOSE_DEVICE,"RX polling: budget=%ld interval=%ldus\n", (LONG)lowLevelDriver->rxPollBudget,
+          (LONG)lowLevelDriver->rxPollInterval));
+    DEBUGOUT((VERBOSE_DEVICE,"TX auto enqueue: %ld\n", (LONG)lowLevelDriver->txAutoEnqueue));
+    DEBUGOUT((VERBOSE_DEVICE,"Bottom half: %ld\n", (LONG)(lowLevelDriver->bottomHalf != NULL)));
+    DEBUGOUT((VERBOSE_DEVICE,"Checksum offload: %ld\n", (LONG)lowLevelDriver->checksumOffload));
+    DEBUGOUT((VERBOSE_DEVICE,"TX mode: %s\n", deviceUnit->eu_TxMode == TX_MODE_UNIT ? "unit process" : "caller task"));
+    DEBUGOUT((VERBOSE_DEVICE,"Park pool: slots=%ld per opener=%ld\n", (LONG)deviceUnit->eu_RxParkSlots,
+          (LONG)deviceUnit->eu_RxParkPerOpener));
+    DEBUGOUT((VERBOSE_DEVICE,"Pools: openers=%ld tracked types=%ld multicast addresses=%ld\n",
+          (LONG)deviceUnit->eu_OpenerPool.fp_Objects, (LONG)deviceUnit->eu_TrackPool.fp_Objects,
+          (LONG)deviceUnit->eu_MulticastPool.fp_Objects));
 
     return true;
 }
@@ -902,6 +1058,21 @@ VOID ExpungeUnit(UBYTE unitNumber, struct DeviceDriver *etherDevice)
 
       DEBUGOUT((VERBOSE_DEVICE,"ExpungeUnit():22\n"));
 
+      //Packet types that are still tracked and multicast addresses that are still used: their memory
+      //belongs to the pools of the unit.
+      ObtainSemaphore(&etherDevice->ed_MCAF_Lock);
+      NewList((struct List *)&etherDevice->ed_MCAF);
+      etherDevice->ed_MCAF_Count = 0;
+      ReleaseSemaphore(&etherDevice->ed_MCAF_Lock);
+
+      PoolDestroy(&etherUnit->eu_OpenerPool);
+      PoolDestroy(&etherUnit->eu_TrackPool);
+      PoolDestroy(&etherUnit->eu_MulticastPool);
+
+      if (etherUnit->eu_RxPark) {
+         FreeMem(etherUnit->eu_RxPark, sizeof(struct RxParkedFrame) * etherUnit->eu_RxParkSlots);
+      }
+
       FreeMem(etherUnit, sizeof(struct DeviceDriverUnit));
 
       etherDevice->ed_Units[unitNumber] = NULL;
@@ -946,12 +1117,9 @@ SAVEDS void DevProcEntry(void)
     etherUnit->eu_Unit.unit_MsgPort.mp_SigTask = (struct Task *)proc;
     etherUnit->eu_Unit.unit_MsgPort.mp_Flags   = PA_SIGNAL;
 
-    //Init the transmit packet list. At this time the unit process does not send
-    //the TX packets, so the unit process is not signaled for this anymore...
+    //Init the transmit packet list (signal of the unit process). Whether the port signals the unit process
+    //for every queued write request depends on TXMODE: ReadConfig sets mp_Flags.
     etherUnit->eu_Tx = CreateMsgPort();
-    /*etherUnit->eu_Tx->mp_SigBit  = AllocSignal(-1L);
-    etherUnit->eu_Tx->mp_SigTask = (struct Task *)proc;
-    etherUnit->eu_Tx->mp_Flags   = PA_SIGNAL;*/
 
     /* Everything ok... */
     etherUnit->eu_Proc = proc;
@@ -967,6 +1135,20 @@ SAVEDS void DevProcEntry(void)
     //Read-in the configuration file of the unit
     ReadConfig(globEtherDevice, etherUnit, lowLevelDriver->getConfigFileName());
 
+    //Objects of the pools. Without memory the pool stays empty (opening the device fails).
+    PoolInit(&etherUnit->eu_OpenerPool, sizeof(struct BufferManagement));
+    PoolInit(&etherUnit->eu_TrackPool, sizeof(struct SuperS2PTStats));
+    PoolInit(&etherUnit->eu_MulticastPool, sizeof(struct MCAF_Address));
+
+    //Slots of the park pool. Without memory the packets are dropped as before.
+    if (etherUnit->eu_RxParkSlots) {
+       etherUnit->eu_RxPark = AllocMem(sizeof(struct RxParkedFrame) * etherUnit->eu_RxParkSlots,
+             MEMF_CLEAR | MEMF_PUBLIC);
+       if (!etherUnit->eu_RxPark) {
+          etherUnit->eu_RxParkSlots = 0;
+       }
+    }
+
     // Init DOS Notify for configuration file
     const char * sConfigFile = lowLevelDriver->getConfigFileName();
     configFileNotifySigBit                       = AllocSignal(-1);
@@ -999,6 +1181,13 @@ SAVEDS void DevProcEntry(void)
                etherUnit->eu_lowLevelDriver->processEvents(etherUnit->eu_lowLevelDriver);
             }
 
+            // TX FIFO got space while the bottom half was running? (It can't wait for the TX lock)
+            // Or new write requests to send (TX_MODE_UNIT)?
+            if (etherUnit->eu_TxSpacePending || (receivedSignals & (1L << etherUnit->eu_Tx->mp_SigBit))) {
+               etherUnit->eu_TxSpacePending = FALSE;
+               sendAllPackets(etherUnit, globEtherDevice);
+            }
+
             // New IORequest to process by the unit process?
             if ((receivedSignals & (1l << etherUnit->eu_Unit.unit_MsgPort.mp_SigBit)))
             {
@@ -1118,13 +1307,12 @@ VOID PerformIO(struct IOSana2Req *ios2,
        case CMD_FLUSH:                DevCmdFlush(ios2,etherUnit,EtherDevice);
                                       break;
 
-       //TODO: Add support:
-/*        case S2_ADDMULTICASTADDRESS:   DevCmdAddMulti(ios2,etherUnit,EtherDevice);
+        case S2_ADDMULTICASTADDRESS:   DevCmdAddMulti(ios2,etherUnit,EtherDevice);
                                        break;
 
         case S2_DELMULTICASTADDRESS:   DevCmdRemMulti(ios2,etherUnit,EtherDevice);
                                        break;
-*/
+
         case S2_ONEVENT:               DevCmdOnEvent(ios2,etherUnit,EtherDevice);
                                        break;
 
@@ -1161,13 +1349,7 @@ VOID PerformIO(struct IOSana2Req *ios2,
         case NSCMD_DEVICEQUERY:        DevCmdNSDeviceQuery(ios2,etherUnit,EtherDevice);
                                        break;
 
-        // These commands are currently not supported by Etherbridge
-
-        case S2_GETTYPESTATS:       
-                                       DEBUGOUT((VERBOSE_DEVICE,"*GetTypeStats nicht unterstuetzt!!\n"));
-                                       ios2->ios2_Req.io_Error = S2ERR_NOT_SUPPORTED;
-                                       ios2->ios2_WireError = S2WERR_GENERIC_ERROR;
-                                       TermIO(ios2,EtherDevice);
+        case S2_GETTYPESTATS:          DevCmdGetTypeStats(ios2,etherUnit,EtherDevice);
                                        break;
 
         default:
@@ -1262,8 +1444,10 @@ VOID DevCmdWritePacket(STDETHERARGS)
             ios2->ios2_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
             PutMsg((APTR)etherUnit->eu_Tx,(APTR)ios2);
 
-            /* now try to send all pending send packets... */
-            sendAllPackets(etherUnit,etherDevice);
+            /* now try to send all pending send packets (or the signaled unit process does it)... */
+            if (etherUnit->eu_TxMode == TX_MODE_CALLER) {
+               sendAllPackets(etherUnit,etherDevice);
+            }
         }
         else
         {
@@ -1286,6 +1470,70 @@ VOID DevCmdWritePacket(STDETHERARGS)
 #define MIN(a,b) ((a) < (b)) ? (a) : (b)
 
 
+/*
+ * Fills the addresses, packet type, data length and broadcast/multicast flags of a read request from the
+ * Ethernet header of a received packet. Returns the offset of the data for the request in the packet
+ * (0 for RAW requests, else the size of the Ethernet header).
+ */
+static uint16_t setupReadIORequest(struct IOSana2Req * ios2,
+                                   uint8_t * rawEtherPacket,
+                                   uint16_t rawPacketLength)
+{
+   MacAddr * dstAddress   = (MacAddr *) (rawEtherPacket+0);
+   MacAddr * srcAddress   = (MacAddr *) (rawEtherPacket+6);
+   uint16_t pktType       = *(uint16_t*)(rawEtherPacket+12);
+   uint16_t dataOffset    = 0;
+
+   if(!(ios2->ios2_Req.io_Flags & SANA2IOF_RAW)) {
+
+      //
+      // Cooked:
+      //
+
+      //Tighten the packet to only the payload itself...
+      dataOffset = 14;
+      rawPacketLength -= 14;
+
+      //Respect MTU...
+      if (rawPacketLength > 1500) {
+         rawPacketLength = 1500;
+      }
+   } else {
+
+      //
+      // RAW:
+      //
+
+      //Respect MTU 1500 + Ethernet Header
+      if (rawPacketLength > 1514) {
+         rawPacketLength = 1514;
+      }
+   }
+
+   //Copy addresses
+   copyEthernetAddress((uint8_t*)dstAddress ,ios2->ios2_DstAddr);  // Destination address
+   copyEthernetAddress((uint8_t*)srcAddress ,ios2->ios2_SrcAddr);  // Source Address
+   //Copy packet type + packet length....
+   ios2->ios2_PacketType = pktType;
+   ios2->ios2_DataLength = rawPacketLength;
+
+   //Check Broadcast / Multicast (bit 0 of first byte is "1" if multicast or broadcast)
+   if ((dstAddress->b[0] & 1) != 0 ) {
+      if (isBroadcastEthernetAddress((uint8_t*)dstAddress)) {
+         ios2->ios2_Req.io_Flags |= SANA2IOF_BCAST;
+      } else {
+         ios2->ios2_Req.io_Flags |= SANA2IOF_MCAST;
+      }
+   }
+
+   DEBUGOUT((VERBOSE_HW, "  IOReq DST    : ")); printEthernetAddress(ios2->ios2_DstAddr);  DEBUGOUT((VERBOSE_HW, "\n"));
+   DEBUGOUT((VERBOSE_HW, "  IOReq SRC    : ")); printEthernetAddress(ios2->ios2_SrcAddr);  DEBUGOUT((VERBOSE_HW, "\n"));
+   DEBUGOUT((VERBOSE_HW, "  IOReq LEN    : %ld\n", (ULONG)ios2->ios2_DataLength));
+   DEBUGOUT((VERBOSE_HW, "  IOReq TYP    : 0x%lx\n", (ULONG)ios2->ios2_PacketType));
+
+   return dataOffset;
+}
+
 /*
  * Copy packet to given Sana 2 request. Returns true if packet was copied to the request.
  * Returns falls when not for some reason.
@@ -1299,61 +1547,14 @@ BOOL fulfillReadIORequest( struct DeviceDriver * etherDevice,
 {
    struct BufferManagement * bm;
    BOOL bStatus=FALSE;
-   MacAddr * dstAddress   = (MacAddr *) (rawEtherPacket+0);
-   MacAddr * srcAddress   = (MacAddr *) (rawEtherPacket+6);
-   uint16_t pktType       = *(uint16_t*)(rawEtherPacket+12);
-   uint8_t * pktDataForIORequest = rawEtherPacket;
+   uint8_t * pktDataForIORequest;
 
 
    bm = ios2->ios2_BufferManagement;
    if (bm)
    {
-      if(!(ios2->ios2_Req.io_Flags & SANA2IOF_RAW)) {
-
-         //
-         // Cooked:
-         //
-
-         //Tighten the packet to only the payload itself...
-         pktDataForIORequest += 14;
-         rawPacketLength -= 14;
-
-         //Respect MTU...
-         if (rawPacketLength > 1500) {
-            rawPacketLength = 1500;
-         }
-      } else {
-
-         //
-         // RAW:
-         //
-
-         //Respect MTU 1500 + Ethernet Header
-         if (rawPacketLength > 1514) {
-            rawPacketLength = 1514;
-         }
-      }
-
-      //Copy addresses
-      copyEthernetAddress((uint8_t*)dstAddress ,ios2->ios2_DstAddr);  // Destination address
-      copyEthernetAddress((uint8_t*)srcAddress ,ios2->ios2_SrcAddr);  // Source Address
-      //Copy packet type + packet length....
-      ios2->ios2_PacketType = pktType;
-      ios2->ios2_DataLength = rawPacketLength;
-
-      //Check Broadcast / Multicast (bit 0 of first byte is "1" if multicast or broadcast)
-      if ((dstAddress->b[0] & 1) != 0 ) {
-         if (isBroadcastEthernetAddress((uint8_t*)dstAddress)) {
-            ios2->ios2_Req.io_Flags |= SANA2IOF_BCAST;
-         } else {
-            ios2->ios2_Req.io_Flags |= SANA2IOF_MCAST;
-         }
-      }
-
-      DEBUGOUT((VERBOSE_HW, "  IOReq DST    : ")); printEthernetAddress(ios2->ios2_DstAddr);  DEBUGOUT((VERBOSE_HW, "\n"));
-      DEBUGOUT((VERBOSE_HW, "  IOReq SRC    : ")); printEthernetAddress(ios2->ios2_SrcAddr);  DEBUGOUT((VERBOSE_HW, "\n"));
-      DEBUGOUT((VERBOSE_HW, "  IOReq LEN    : %ld\n", (ULONG)ios2->ios2_DataLength));
-      DEBUGOUT((VERBOSE_HW, "  IOReq TYP    : 0x%lx\n", (ULONG)ios2->ios2_PacketType));
+      pktDataForIORequest = rawEtherPacket + setupReadIORequest(ios2, rawEtherPacket, rawPacketLength);
+      rawPacketLength     = ios2->ios2_DataLength;
 
       // Frage Stack, ob er das Packet auch wirklich moechte (Paketfilter)!
       if(CallFilterHook(bm->bm_PacketFilterHook, ios2, pktDataForIORequest))
@@ -1363,48 +1564,527 @@ BOOL fulfillReadIORequest( struct DeviceDriver * etherDevice,
          {
             DEBUGOUT((VERBOSE_HW,"Pkt copied successfully:\n"));
             dumpMem(pktDataForIORequest,rawPacketLength);
+            bm->bm_Stats.bs_FramesReceived++;
+            bm->bm_Stats.bs_BytesReceived += rawPacketLength;
             bStatus = true;
          }
          else
          {
             DEBUGOUT((VERBOSE_HW,"  Error CopyToBuffer()!\n"));
+            bm->bm_Stats.bs_CopyFailures++;
             ios2->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
             ios2->ios2_WireError    = S2WERR_BUFF_ERROR;
             DoEvent(S2EVENT_BUFF,etherUnit,globEtherDevice);
          }
 
-         //Remove() is safe because we are in List lock when this function is called.
+         //Remove() is safe because we are in List lock when this function is called. The request is
+         //either in its type slot or in bm_RxQueue (or the read orphan list): all stay consistent.
          Remove((APTR)ios2);
+         if (ios2->ios2_Req.io_Command != S2_READORPHAN)
+            bm->bm_Stats.bs_ReadsPending--;
          TermIO(ios2,etherDevice);
       } else {
          DEBUGOUT((VERBOSE_HW,"  Filter hook passed. Result: Packet SKIPPED!\n"));
+         bm->bm_Stats.bs_FilterRejects++;
       }
    }
 
    return bStatus;
 }
 
+/*
+ * Returns the oldest read request of the opener that wants packets of the given type (EthernetII or IEEE 802.3).
+ * The bm_RxQueueLock must be held.
+ */
+static struct IOSana2Req * findReadIORequest(struct BufferManagement * bm, uint16_t packetType)
+{
+   struct IOSana2Req *ios2;
+   struct MinList * list = getReadQueue(bm, packetType, FALSE);
+
+   //The type has its own slot: the first request is the one
+   if (list != &bm->bm_RxQueue) {
+      return IsListEmpty((struct List *)list) ? NULL : GET_FIRST(*list);
+   }
+
+   for (ios2 = GET_FIRST(*list);
+         ios2->ios2_Req.io_Message.mn_Node.ln_Succ;
+         ios2 = (struct IOSana2Req *) (ios2->ios2_Req.io_Message.mn_Node.ln_Succ)) {
+      if (ios2->ios2_PacketType == packetType) {
+         return ios2;
+      }
+   }
+   return NULL;
+}
+
+/*
+ * The opener has no read request for a packet of the given type (see findReadIORequest). It misses the
+ * packet when it reads this type, i.e. the type owns a slot (IEEE 802.3 and the types in bm_RxQueue are
+ * not known to be read). The bm_RxQueueLock must be held.
+ */
+static inline BOOL isReadQueueStarving(struct BufferManagement * bm, uint16_t packetType)
+{
+   return packetType > 1500 && getReadQueue(bm, packetType, FALSE) != &bm->bm_RxQueue;
+}
+
+/*
+ * Locks of the receive lists. In the bottom half (software interrupt) no task runs and the locks were free
+ * when it started (see bottomHalf): the lists are used without the semaphores there.
+ *
+ * Lock order: The receive callbacks run with the NIC locked and wait for eu_BuffMgmtLock, bm_RxQueueLock,
+ * eu_ReadOrphanLock and eu_RxParkLock (onPktHeader only attempts them). So none of these locks may be held
+ * while a function of the lowleveldriver is called. ed_MCAF_Lock is held while calling it (updateMulticastFilter),
+ * the receive path only attempts it (like eu_TrackLock).
+ */
+static inline void obtainRxLock(struct DeviceDriverUnit * etherUnit, struct SignalSemaphore * lock) {
+   if (!etherUnit->eu_InBottomHalf) {
+      ObtainSemaphore(lock);
+   }
+}
+
+static inline BOOL attemptRxLock(struct DeviceDriverUnit * etherUnit, struct SignalSemaphore * lock) {
+   return etherUnit->eu_InBottomHalf || AttemptSemaphore(lock);
+}
+
+static inline void releaseRxLock(struct DeviceDriverUnit * etherUnit, struct SignalSemaphore * lock) {
+   if (!etherUnit->eu_InBottomHalf) {
+      ReleaseSemaphore(lock);
+   }
+}
+
+/*
+ * Park pool (config RXPARKSLOTS): A packet for an opener whose read queue of the packet type is empty (see
+ * isReadQueueStarving) waits in a slot until the opener queues the next read (see DevCmdReadPacket). When the
+ * opener used up its budget (RXPARKPEROPENER) its oldest packet makes room, when all slots are used the oldest
+ * packet of all openers. The bm_RxQueueLock of the opener must be held.
+ * @return TRUE if the packet was parked
+ */
+static BOOL parkFrame(struct DeviceDriverUnit * etherUnit, struct BufferManagement * bm, uint8_t * frame,
+      uint16_t size)
+{
+   struct RxParkedFrame * slot = NULL;
+   struct RxParkedFrame * oldest = NULL;
+   const BOOL ownOnly = bm->bm_Parked >= etherUnit->eu_RxParkPerOpener;
+   UWORD i;
+
+   if (!etherUnit->eu_RxPark || !etherUnit->eu_RxParkPerOpener) {
+      return FALSE;
+   }
+
+   obtainRxLock(etherUnit, &etherUnit->eu_RxParkLock);
+   for (i = 0; i < etherUnit->eu_RxParkSlots; i++) {
+      struct RxParkedFrame * parked = &etherUnit->eu_RxPark[i];
+      if (!parked->rf_Owner) {
+         if (!ownOnly) {
+            slot = parked;
+            break;
+         }
+      } else if ((!ownOnly || parked->rf_Owner == bm)
+            && (!oldest || (LONG)(parked->rf_Age - oldest->rf_Age) < 0)) {
+         oldest = parked;
+      }
+   }
+
+   //Budget used up: the oldest packet is evicted
+   if (!slot && oldest) {
+      slot = oldest;
+      slot->rf_Owner->bm_Parked--;
+      etherUnit->eu_RxParkEvictions++;
+   }
+
+   if (slot) {
+      if (size > RX_PARK_FRAME_SIZE) {
+         size = RX_PARK_FRAME_SIZE;
+      }
+      slot->rf_Owner = bm;
+      slot->rf_Age   = etherUnit->eu_RxParkAge++;
+      slot->rf_Size  = size;
+      slot->rf_Type  = *(uint16_t*)(frame + 12);
+      CopyMem(frame, slot->rf_Data, size);
+      bm->bm_Parked++;
+   }
+   releaseRxLock(etherUnit, &etherUnit->eu_RxParkLock);
+
+   return slot != NULL;
+}
+
+/*
+ * Hands the oldest parked packet of the opener and the type of the queued read request over (see parkFrame).
+ * Called by the opener's task with the bm_RxQueueLock held.
+ */
+static void deliverParkedFrame(struct DeviceDriverUnit * etherUnit, struct BufferManagement * bm,
+      struct IOSana2Req * ios2)
+{
+   struct RxParkedFrame * oldest = NULL;
+   UWORD i;
+
+   if (!bm->bm_Parked) {
+      return;
+   }
+
+   ObtainSemaphore(&etherUnit->eu_RxParkLock);
+   for (i = 0; i < etherUnit->eu_RxParkSlots; i++) {
+      struct RxParkedFrame * parked = &etherUnit->eu_RxPark[i];
+      if (parked->rf_Owner == bm && parked->rf_Type == ios2->ios2_PacketType
+            && (!oldest || (LONG)(parked->rf_Age - oldest->rf_Age) < 0)) {
+         oldest = parked;
+      }
+   }
+   if (oldest) {
+      if (fulfillReadIORequest(globEtherDevice, etherUnit, ios2, oldest->rf_Data, oldest->rf_Size)) {
+         etherUnit->eu_RxParkHits++;
+      } else {
+         etherUnit->eu_RxParkMisses++;
+      }
+      oldest->rf_Owner = NULL;
+      bm->bm_Parked--;
+   }
+   ReleaseSemaphore(&etherUnit->eu_RxParkLock);
+}
+
+/*
+ * Drops the parked packets of an opener (flush or close).
+ */
+static void discardParkedFrames(struct DeviceDriverUnit * etherUnit, struct BufferManagement * bm)
+{
+   UWORD i;
+
+   ObtainSemaphore(&etherUnit->eu_RxParkLock);
+   for (i = 0; i < etherUnit->eu_RxParkSlots && bm->bm_Parked; i++) {
+      if (etherUnit->eu_RxPark[i].rf_Owner == bm) {
+         etherUnit->eu_RxPark[i].rf_Owner = NULL;
+         etherUnit->eu_RxParkMisses++;
+         bm->bm_Parked--;
+      }
+   }
+   ReleaseSemaphore(&etherUnit->eu_RxParkLock);
+}
+
+//Nobody owns the semaphore or waits for it
+#define IS_SEMAPHORE_FREE(s) ((s)->ss_QueueCount == -1)
+
+/**
+ * Statistics of a tracked packet type (eu_TrackLock must be held): one slot of the direct mapped table, a
+ * second type in the same slot is rare.
+ * @param etherUnit
+ * @param packetType
+ * @return statistics or NULL if the type is not tracked
+ */
+static struct SuperS2PTStats * getTypeStats(struct DeviceDriverUnit * etherUnit, ULONG packetType)
+{
+   struct SuperS2PTStats * stats = etherUnit->eu_Track[TRACK_TYPE_SLOT(packetType)];
+   while (stats && stats->ss_PType != packetType) {
+      stats = stats->ss_Next;
+   }
+   return stats;
+}
+
+/**
+ * Counts a packet in the statistics of its type (S2_TRACKTYPE). Nothing tracked in the slot: no lock at all.
+ * Can't wait for the lock here: while a type is tracked or untracked, the packet isn't counted.
+ * @param etherUnit
+ * @param packetType
+ * @param event TYPE_STAT_SENT, TYPE_STAT_RECEIVED or TYPE_STAT_DROPPED
+ * @param bytes data length of the packet
+ */
+static void countTypeStats(struct DeviceDriverUnit * etherUnit, ULONG packetType, UWORD event, ULONG bytes)
+{
+   struct SuperS2PTStats * stats;
+
+   if (etherUnit->eu_Track[TRACK_TYPE_SLOT(packetType)] == NULL
+         || !attemptRxLock(etherUnit, &etherUnit->eu_TrackLock)) {
+      return;
+   }
+   stats = getTypeStats(etherUnit, packetType);
+   if (stats) {
+      switch (event) {
+         case TYPE_STAT_SENT:
+            stats->ss_Stats.PacketsSent++;
+            stats->ss_Stats.BytesSent += bytes;
+            break;
+         case TYPE_STAT_RECEIVED:
+            stats->ss_Stats.PacketsReceived++;
+            stats->ss_Stats.BytesReceived += bytes;
+            break;
+         default:
+            stats->ss_Stats.PacketsDropped++;
+            break;
+      }
+   }
+   releaseRxLock(etherUnit, &etherUnit->eu_TrackLock);
+}
+
+/**
+ * Software interrupt of the unit (bottom half, config BOTTOMHALF): Queued by the ISR of the lowleveldriver
+ * with Cause() instead of signaling the unit process. So the received packets are delivered right after
+ * the interrupt and don't wait until the unit process is scheduled behind all other ready tasks.
+ *
+ * No task runs until we return, so a free lock stays free. If the interrupted task just uses a receive
+ * list or the NIC, the unit process does the job (as without bottom half).
+ */
+static void bottomHalf(REG(a1, struct DeviceDriverUnit * etherUnit)) {
+   NetInterface * lowLevelDriver = etherUnit->eu_lowLevelDriver;
+   struct BufferManagement *bm;
+   BOOL locksFree = IS_SEMAPHORE_FREE(&etherUnit->eu_BuffMgmtLock) && IS_SEMAPHORE_FREE(&etherUnit->eu_ReadOrphanLock)
+         && IS_SEMAPHORE_FREE(&globEtherDevice->ed_MCAF_Lock) && IS_SEMAPHORE_FREE(&etherUnit->eu_TrackLock)
+         && IS_SEMAPHORE_FREE(&etherUnit->eu_RxParkLock);
+
+   for (bm = (struct BufferManagement *) etherUnit->eu_BuffMgmt.mlh_Head;
+         locksFree && bm->bm_Node.mln_Succ;
+         bm = (struct BufferManagement *) bm->bm_Node.mln_Succ) {
+      locksFree = IS_SEMAPHORE_FREE(&bm->bm_RxQueueLock);
+   }
+
+   if (locksFree) {
+      BOOL done;
+      etherUnit->eu_InBottomHalf = TRUE;
+      done = lowLevelDriver->processEventsInterrupt(lowLevelDriver);
+      etherUnit->eu_InBottomHalf = FALSE;
+      if (done) {
+         return;
+      }
+   }
+   Signal(&etherUnit->eu_Proc->pr_Task, 1L << etherUnit->eu_lowLevelDriverSignalNumber);
+}
+
+/**
+ * Exact multicast filter: The hash filter of the NIC also passes the frames of addresses nobody added (same
+ * hash), with more than MAC_MULTICAST_FILTER_SIZE addresses even all multicast frames. Broadcasts always pass.
+ * While the address list is changed the frame passes too (can't wait here, the stack checks it anyway).
+ * @param etherUnit
+ * @param address destination address of a multicast frame
+ * @return FALSE if nobody added the address
+ */
+static BOOL isWantedMulticast(struct DeviceDriverUnit * etherUnit, const UBYTE * address)
+{
+   BOOL wanted = TRUE;
+
+   if (0 == memcmp(address, BROADCAST_ADDRESS, 6) || (etherUnit->eu_State & ETHERUF_PROMISC)) {
+      return TRUE;
+   }
+   if (attemptRxLock(etherUnit, &globEtherDevice->ed_MCAF_Lock)) {
+      wanted = findMulticastAddress(address) != NULL;
+      releaseRxLock(etherUnit, &globEtherDevice->ed_MCAF_Lock);
+   }
+   return wanted;
+}
+
+/**
+ * Entry point of the lowleveldriver, the Ethernet header of a packet was received. The payload is
+ * still in the NIC.
+ *
+ * If no request wants the packet it is discarded in the NIC without reading the payload.
+ * If exactly one request wants the packet and its opener supports S2_DMACopyToBuff32, the request is
+ * taken from its queue and the buffer of the stack is returned to the lowleveldriver, which reads the
+ * payload directly into it (no copy through the receive buffer). Everything else goes the normal way
+ * (onPktReceived).
+ *
+ * Called with the NIC locked (receive path of the lowleveldriver): never wait for a lock here. The lock of
+ * the taker's list stays held from the lookup until the request is removed: no AbortIO, CMD_FLUSH or
+ * CloseDevice of another task can reply it in the meantime.
+ */
+static RxDeliveryMode onPktHeader(NetInterface * interface, uint8_t * header, uint16_t size, uint8_t ** payloadBuffer) {
+   struct BufferManagement *bm;
+   struct IOSana2Req *ios2;
+   struct IOSana2Req *taker = NULL;
+   struct SignalSemaphore *takerLock = NULL;
+   struct BufferManagement *starving[RX_STARVING_MAX];
+   UWORD starvingCount = 0;
+   UWORD takers = 0;
+   BOOL listsBusy = FALSE;
+   BOOL tooManyStarving = FALSE;
+   uint8_t * buffer;
+   const uint16_t packetType = *(uint16_t*)(header+12);
+   struct DeviceDriverUnit * etherUnit = UNIT_OF(interface);
+
+   etherUnit->eu_RxStarvationCounted = FALSE;
+
+   //Multicast of an address nobody added (hash collision): Drop it before the payload is read
+   if ((header[0] & 0x01) && !isWantedMulticast(etherUnit, header)) {
+      DEBUGOUT((VERBOSE_HW, "Multicast packet for an unused address discarded!\n"));
+      return RX_DELIVER_DISCARD;
+   }
+
+   //Frames longer than the MTU are clipped: that's only possible with a copy.
+   if (size > etherUnit->eu_MTU + 14) {
+      return RX_DELIVER_COPY;
+   }
+
+   //Someone is just changing the lists. Can't wait here, so use the normal way.
+   if (!attemptRxLock(etherUnit, &etherUnit->eu_BuffMgmtLock)) {
+      return RX_DELIVER_COPY;
+   }
+   for (bm = (struct BufferManagement *) etherUnit->eu_BuffMgmt.mlh_Head;
+         bm->bm_Node.mln_Succ && takers < 2;
+         bm = (struct BufferManagement *) bm->bm_Node.mln_Succ) {
+      if (!attemptRxLock(etherUnit, &bm->bm_RxQueueLock)) {
+         listsBusy = TRUE;
+         break;
+      }
+      ios2 = findReadIORequest(bm, packetType);
+      if (ios2) {
+         //The list of the taker stays locked (a second taker means copy anyway)
+         if (takerLock) {
+            releaseRxLock(etherUnit, takerLock);
+         }
+         taker     = ios2;
+         takerLock = &bm->bm_RxQueueLock;
+         takers++;
+         continue;
+      } else if (isReadQueueStarving(bm, packetType)) {
+         if (starvingCount < RX_STARVING_MAX) {
+            starving[starvingCount++] = bm;
+         } else {
+            tooManyStarving = TRUE;
+         }
+      }
+      releaseRxLock(etherUnit, &bm->bm_RxQueueLock);
+   }
+   //Packets for the park pool need the payload: onPktReceived parks them. It also counts the missed packets
+   //when there are more starving openers than remembered here (a discarded packet would never count them).
+   if (tooManyStarving || (starvingCount && etherUnit->eu_RxPark && etherUnit->eu_RxParkPerOpener)) {
+      releaseRxLock(etherUnit, &etherUnit->eu_BuffMgmtLock);
+      goto copy;
+   }
+   //All openers were asked: count the missed packets here, onPktReceived must not count them again.
+   if (!listsBusy && takers < 2) {
+      while (starvingCount) {
+         starving[--starvingCount]->bm_Stats.bs_EmptyQueueDrops++;
+      }
+      etherUnit->eu_RxStarvationCounted = TRUE;
+   }
+   releaseRxLock(etherUnit, &etherUnit->eu_BuffMgmtLock);
+
+   //Nobody wants the packet: The first read orphan gets it (its list stays locked).
+   if (takers == 0 && !listsBusy) {
+      if (attemptRxLock(etherUnit, &etherUnit->eu_ReadOrphanLock)) {
+         if (!IsListEmpty((struct List* )&etherUnit->eu_ReadOrphan)) {
+            taker     = GET_FIRST(etherUnit->eu_ReadOrphan);
+            takerLock = &etherUnit->eu_ReadOrphanLock;
+            takers++;
+         } else {
+            releaseRxLock(etherUnit, &etherUnit->eu_ReadOrphanLock);
+         }
+      } else {
+         listsBusy = TRUE;
+      }
+   }
+
+   //Not even a read orphan: Drop the packet in the NIC, the payload is never read.
+   if (takers == 0 && !listsBusy) {
+      DEBUGOUT((VERBOSE_HW, "No request for packet (type 0x%lx). Packet discarded!\n", (ULONG)packetType));
+      GlobStat.PacketsReceived++;
+      GlobStat.UnknownTypesReceived++;
+      countTypeStats(etherUnit, packetType, TYPE_STAT_DROPPED, 0);
+      return RX_DELIVER_DISCARD;
+   }
+
+   //Each opener gets its own copy of the packet: DMA only with a single taker.
+   if (takers != 1 || listsBusy) {
+      goto copy;
+   }
+
+   bm = taker->ios2_BufferManagement;
+   if (!bm || !bm->bm_CopyToBufferDMA) {
+      goto copy;
+   }
+
+   //The DMA function of the stack needs the data length of the request.
+   uint16_t dataOffset = setupReadIORequest(taker, header, size);
+   buffer = CopyToBufferDMA(taker->ios2_Data);
+
+   //The lowleveldriver reads words from the NIC...
+   if (!buffer || ((ULONG)buffer & 1)) {
+      goto copy;
+   }
+
+   if (dataOffset == 0) {
+      //RAW: The Ethernet header is part of the data
+      CopyMem(header, buffer, 14);
+      *payloadBuffer = buffer + 14;
+   } else {
+      *payloadBuffer = buffer;
+   }
+
+   //Still locked since the lookup: the request is in the list
+   Remove((struct Node *) taker);
+   if (takerLock != &etherUnit->eu_ReadOrphanLock) {
+      bm->bm_Stats.bs_ReadsPending--;
+   }
+   releaseRxLock(etherUnit, takerLock);
+
+   etherUnit->eu_RxDirect     = taker;
+   etherUnit->eu_RxDirectData = buffer;
+   return RX_DELIVER_DIRECT;
+
+copy:
+   if (takerLock) {
+      releaseRxLock(etherUnit, takerLock);
+   }
+   return RX_DELIVER_COPY;
+}
+
+/**
+ * Entry point of the lowleveldriver, the payload of a packet was read into the buffer of the stack
+ * (see onPktHeader).
+ */
+static void onPktPayloadReceived(NetInterface * interface, uint8_t * header, uint16_t size) {
+   TRACE_DEBUG("onPktPayloadReceived:\n");
+
+   struct DeviceDriverUnit * etherUnit = UNIT_OF(interface);
+   struct IOSana2Req * ios2 = etherUnit->eu_RxDirect;
+   struct BufferManagement * bm = ios2->ios2_BufferManagement;
+
+   etherUnit->eu_RxDirect = NULL;
+   GlobStat.PacketsReceived++;
+
+   // Frage Stack, ob er das Packet auch wirklich moechte (Paketfilter)!
+   if (CallFilterHook(bm->bm_PacketFilterHook, ios2, etherUnit->eu_RxDirectData)) {
+      DEBUGOUT((VERBOSE_HW,"Pkt transferred directly (DMA):\n"));
+      dumpMem(etherUnit->eu_RxDirectData, ios2->ios2_DataLength);
+      countTypeStats(etherUnit, *(uint16_t*)(header + 12), TYPE_STAT_RECEIVED, size - ETHER_PACKET_HEAD_SIZE);
+      bm->bm_Stats.bs_FramesReceived++;
+      bm->bm_Stats.bs_BytesReceived += ios2->ios2_DataLength;
+      TermIO(ios2, globEtherDevice);
+   } else {
+      //Skipped: The request waits for the next packet again (at its old place).
+      DEBUGOUT((VERBOSE_HW,"  Filter hook passed. Result: Packet SKIPPED!\n"));
+      countTypeStats(etherUnit, *(uint16_t*)(header + 12), TYPE_STAT_DROPPED, 0);
+      bm->bm_Stats.bs_FilterRejects++;
+      if (ios2->ios2_Req.io_Command == S2_READORPHAN) {
+         obtainRxLock(etherUnit, &etherUnit->eu_ReadOrphanLock);
+         AddHead((struct List *) &etherUnit->eu_ReadOrphan, (struct Node *) ios2);
+         releaseRxLock(etherUnit, &etherUnit->eu_ReadOrphanLock);
+      } else {
+         obtainRxLock(etherUnit, &bm->bm_RxQueueLock);
+         AddHead((struct List *) getReadQueue(bm, ios2->ios2_PacketType, FALSE), (struct Node *) ios2);
+         bm->bm_Stats.bs_ReadsPending++;
+         releaseRxLock(etherUnit, &bm->bm_RxQueueLock);
+      }
+   }
+}
+
 
 /**
  * Entry point of the lowleveldriver, an packet was received...
  */
-static void onPktReceived(uint8_t * buffer, uint16_t size ) {
+static void onPktReceived(NetInterface * interface, uint8_t * buffer, uint16_t size ) {
    TRACE_DEBUG("onPktReceived:\n");
 
    bool resultIsPacketDelivered;
    struct BufferManagement *bm;
    struct IOSana2Req *ios2;
    const uint16_t packetType = *(uint16_t*)(buffer+12);
+   struct DeviceDriverUnit * etherUnit = UNIT_OF(interface);
+   const BOOL countStarvation = !etherUnit->eu_RxStarvationCounted;
 
-   //TODO: Find a way to get back the driver unit that is used here. Currently this is always unit "0".
-   struct DeviceDriverUnit * etherUnit = globEtherDevice->ed_Units[0];
-
+   etherUnit->eu_RxStarvationCounted = FALSE;
+   GlobStat.PacketsReceived++;
 
    //
    // Ask every stack if he wants to get the new packet...
    //
    resultIsPacketDelivered = FALSE;
-   ObtainSemaphore(&etherUnit->eu_BuffMgmtLock);
+   obtainRxLock(etherUnit, &etherUnit->eu_BuffMgmtLock);
    for (bm = (struct BufferManagement *) etherUnit->eu_BuffMgmt.mlh_Head;
          bm->bm_Node.mln_Succ;
          bm = (struct BufferManagement *) bm->bm_Node.mln_Succ) {
@@ -1412,23 +2092,25 @@ static void onPktReceived(uint8_t * buffer, uint16_t size ) {
        ** wurde Packet noch nicht an diesen Stack kopiert ?  UND
        ** gibt es IOReq-Reads in der Liste des Stacks ?
        */
-      ObtainSemaphore((APTR) &bm->bm_RxQueueLock);
-      for (ios2 = GET_FIRST(bm->bm_RxQueue); //
-            ios2->ios2_Req.io_Message.mn_Node.ln_Succ; //
-            ios2 = (struct IOSana2Req *) (ios2->ios2_Req.io_Message.mn_Node.ln_Succ)) {
-
-         /* stimmt Packettyp ? EthernetII or IEEE 802.3 */
-         if ((ios2->ios2_PacketType == packetType)
-               || ((ios2->ios2_PacketType <= 1500) && (packetType <= 1500))) {
-
-            // Copy packet to IORequest...
-            resultIsPacketDelivered = fulfillReadIORequest(globEtherDevice, etherUnit, ios2, buffer, size );
-            break; // Enough for this stack
+      obtainRxLock(etherUnit, &bm->bm_RxQueueLock);
+      /* stimmt Packettyp ? EthernetII or IEEE 802.3 */
+      ios2 = findReadIORequest(bm, packetType);
+      if (ios2) {
+         // Copy packet to IORequest...
+         if (fulfillReadIORequest(globEtherDevice, etherUnit, ios2, buffer, size )) {
+            resultIsPacketDelivered = TRUE;
+         }
+      } else if (isReadQueueStarving(bm, packetType)) {
+         //No read pending: the packet waits in the park pool for the next one
+         if (parkFrame(etherUnit, bm, buffer, size)) {
+            resultIsPacketDelivered = TRUE;
+         } else if (countStarvation) {
+            bm->bm_Stats.bs_EmptyQueueDrops++;
          }
       }
-      ReleaseSemaphore((APTR) &bm->bm_RxQueueLock);
+      releaseRxLock(etherUnit, &bm->bm_RxQueueLock);
    }
-   ReleaseSemaphore(&etherUnit->eu_BuffMgmtLock);
+   releaseRxLock(etherUnit, &etherUnit->eu_BuffMgmtLock);
 
    /*
     * If nobody wants that packet, try to find a read orphan listener who wants that.
@@ -1436,7 +2118,7 @@ static void onPktReceived(uint8_t * buffer, uint16_t size ) {
    if (!resultIsPacketDelivered) {
       BOOL pktTransfered = FALSE;
       DEBUGOUT((VERBOSE_HW, "No regular IORequest fits. Check 'Read Orphan List'...\n"));
-      ObtainSemaphore((APTR) &etherUnit->eu_ReadOrphanLock);
+      obtainRxLock(etherUnit, &etherUnit->eu_ReadOrphanLock);
       struct MinList * readOrphanList = &etherUnit->eu_ReadOrphan;
       if (!IsListEmpty((struct List* )readOrphanList)) {
          struct IOSana2Req * firstOrphan = GET_FIRST(etherUnit->eu_ReadOrphan);
@@ -1445,9 +2127,14 @@ static void onPktReceived(uint8_t * buffer, uint16_t size ) {
       }
       if (!pktTransfered) {
          DEBUGOUT((VERBOSE_HW, "No request for packet. Packet dropped!\n"));
+         GlobStat.UnknownTypesReceived++;
       }
-      ReleaseSemaphore((APTR) &etherUnit->eu_ReadOrphanLock);
+      releaseRxLock(etherUnit, &etherUnit->eu_ReadOrphanLock);
+      resultIsPacketDelivered = pktTransfered;
    }
+
+   countTypeStats(etherUnit, packetType, resultIsPacketDelivered ? TYPE_STAT_RECEIVED : TYPE_STAT_DROPPED,
+         size - ETHER_PACKET_HEAD_SIZE);
 }
 
 
@@ -1471,8 +2158,15 @@ VOID DevCmdOnline(STDETHERARGS)
    {
       DEBUGOUT((VERBOSE_DEVICE,"###Set onReceivePkt callback...\n"));
 
+      //The callbacks find the unit in the user data of the interface
+      etherUnit->eu_lowLevelDriver->userData = etherUnit;
       //Set the callback receive function:
       etherUnit->eu_lowLevelDriver->onPacketReceived = onPktReceived;
+      //...and the zero copy (S2_DMACopyToBuff32) receive functions:
+      etherUnit->eu_lowLevelDriver->onPacketHeader          = onPktHeader;
+      etherUnit->eu_lowLevelDriver->onPacketPayloadReceived = onPktPayloadReceived;
+      //...and the function that sends the deferred packets when the TX FIFO has space again:
+      etherUnit->eu_lowLevelDriver->txSpaceAvailableFunction = onTxSpaceAvailable;
       //Set driver online:
       etherUnit->eu_lowLevelDriver->init  (etherUnit->eu_lowLevelDriver);
       etherUnit->eu_lowLevelDriver->online(etherUnit->eu_lowLevelDriver);
@@ -1539,27 +2233,34 @@ VOID DevCmdReadPacket(STDETHERARGS)
 
    if (etherUnit->eu_State & ETHERUF_ONLINE)
    {
-      /* Find the appropriate queue for this IO request */
-      ObtainSemaphore(&etherUnit->eu_BuffMgmtLock);
-      bm = (struct BufferManagement *) etherUnit->eu_BuffMgmt.mlh_Head;
-      while (bm->bm_Node.mln_Succ) {
-         if (bm == (struct BufferManagement *) ios2->ios2_BufferManagement)
-         {
-            ObtainSemaphore((APTR) &bm->bm_RxQueueLock);
+      BOOL queued = FALSE;
 
+      //The opener must be an object of the opener pool that is open. That's checked in constant time: the
+      //objects of the pool stay valid memory until the unit is expunged, so eu_BuffMgmt isn't walked (and
+      //locked). The tag is checked again with the lock held because DeviceClose clears it with the lock held.
+      bm = (struct BufferManagement *) ios2->ios2_BufferManagement;
+      if (PoolContains(&etherUnit->eu_OpenerPool, bm) && bm->bm_Tag == BM_TAG_OPEN)
+      {
+         ObtainSemaphore((APTR) &bm->bm_RxQueueLock);
+         if (bm->bm_Tag == BM_TAG_OPEN)
+         {
             //Ensure that the request is marked as "pending" because the request can only be queued here...
             ios2->ios2_Req.io_Message.mn_Node.ln_Type = NT_MESSAGE;
 
-            AddTail((struct List *) &bm->bm_RxQueue, (struct Node *) ios2);
-            ReleaseSemaphore((APTR) &bm->bm_RxQueueLock);
-            break;
+            //Queue the request in the list of its packet type
+            AddTail((struct List *) getReadQueue(bm, ios2->ios2_PacketType, TRUE), (struct Node *) ios2);
+            if (++bm->bm_Stats.bs_ReadsPending > bm->bm_Stats.bs_ReadsHighWater)
+               bm->bm_Stats.bs_ReadsHighWater = bm->bm_Stats.bs_ReadsPending;
+
+            //A packet that arrived while no read was pending?
+            deliverParkedFrame(etherUnit, bm, ios2);
+            queued = TRUE;
          }
-         bm = (struct BufferManagement *) bm->bm_Node.mln_Succ;
+         ReleaseSemaphore((APTR) &bm->bm_RxQueueLock);
       }
-      ReleaseSemaphore(&etherUnit->eu_BuffMgmtLock);
 
       //Check if something went wrong, fire error
-      if (!bm->bm_Node.mln_Succ)
+      if (!queued)
       {
          ios2->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
          ios2->ios2_WireError = S2WERR_GENERIC_ERROR;
@@ -1675,6 +2376,7 @@ VOID DevCmdConfigInterface(STDETHERARGS)
        copyEthernetAddress(ios2->ios2_SrcAddr,etherUnit->eu_StAddr);
        etherUnit->eu_lowLevelDriver->setNetworkAddress(etherUnit->eu_lowLevelDriver, (MacAddr*)etherUnit->eu_StAddr);
        etherUnit->eu_State |= ETHERUF_CONFIG;
+       GlobStat.Reconfigurations++;
    
        //Set device also online
        DevCmdOnline(ios2,etherUnit,globEtherDevice);
@@ -1693,39 +2395,37 @@ VOID DevCmdConfigInterface(STDETHERARGS)
 
 ///VOID DevCmdTrackType(STDETHERARGS)
 /*
-** This function adds a packet type to the list
+** This function adds a packet type to the table
 ** of those that are being tracked.
 */
 VOID DevCmdTrackType(STDETHERARGS)
 {
     struct SuperS2PTStats *stats;
+    UWORD slot = TRACK_TYPE_SLOT(ios2->ios2_PacketType);
 
     DEBUGOUT((VERBOSE_DEVICE,"*TrackType\n"));
     ObtainSemaphore((APTR)&etherUnit->eu_TrackLock);
 
-    stats = (struct SuperS2PTStats *)etherUnit->eu_Track.mlh_Head;
-    while(stats->ss_Node.mln_Succ)
+    if (getTypeStats(etherUnit, ios2->ios2_PacketType))
     {
-        if(ios2->ios2_PacketType == stats->ss_PType)
-        {
-            ios2->ios2_Req.io_Error = S2ERR_BAD_STATE;
-            ios2->ios2_WireError = S2WERR_ALREADY_TRACKED;
-            break;
-        }
-        stats = (struct SuperS2PTStats *)stats->ss_Node.mln_Succ;
+        ios2->ios2_Req.io_Error = S2ERR_BAD_STATE;
+        ios2->ios2_WireError = S2WERR_ALREADY_TRACKED;
     }
-
-    if(!stats->ss_Node.mln_Succ)
+    else
     {
-        stats = AllocMem(sizeof(struct SuperS2PTStats),MEMF_CLEAR|MEMF_PUBLIC);
+        stats = PoolAlloc(&etherUnit->eu_TrackPool);
         if(stats)
         {
             stats->ss_PType = ios2->ios2_PacketType;
-            if(ios2->ios2_PacketType == 2048)
-                etherUnit->eu_IPTrack = stats;
-            AddTail((struct List *)&etherUnit->eu_Track,(struct Node     *)stats);
+            stats->ss_Next  = etherUnit->eu_Track[slot];
+            etherUnit->eu_Track[slot] = stats;
             print(5,"Track packet type: "); printi(5,ios2->ios2_PacketType);
         }
+        else
+        {
+            ios2->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
+            ios2->ios2_WireError = S2WERR_GENERIC_ERROR;
+        }
     }
     ReleaseSemaphore((APTR)&etherUnit->eu_TrackLock);
 
@@ -1736,32 +2436,27 @@ VOID DevCmdTrackType(STDETHERARGS)
 ///VOID DevCmdUnTrackType(STDETHERARGS)
 /*
 ** This function removes a packet type from the
-** list of those that are being tracked.
+** table of those that are being tracked.
 */
 VOID DevCmdUnTrackType(STDETHERARGS)
 {
+    struct SuperS2PTStats ** link;
     struct SuperS2PTStats * stats;
-    struct SuperS2PTStats * stats_next;
-    
+
     DEBUGOUT((VERBOSE_DEVICE,"*DevCmdUnTrackType\n"));
     ObtainSemaphore((APTR)&etherUnit->eu_TrackLock);
 
-    stats = (struct SuperS2PTStats *)etherUnit->eu_Track.mlh_Head;
-    while(stats->ss_Node.mln_Succ)
+    link = &etherUnit->eu_Track[TRACK_TYPE_SLOT(ios2->ios2_PacketType)];
+    while ((stats = *link) != NULL && stats->ss_PType != ios2->ios2_PacketType)
     {
-        stats_next = ((struct SuperS2PTStats *)stats->ss_Node.mln_Succ);
-        if(ios2->ios2_PacketType == stats->ss_PType)
-        {
-            if(ios2->ios2_PacketType == 2048)
-                etherUnit->eu_IPTrack = NULL;
-            Remove((struct Node *)stats);
-            FreeMem(stats,sizeof(struct SuperS2PTStats));
-            stats = NULL;
-            break;
-        }
-        stats = stats_next;
+        link = &stats->ss_Next;
     }
     if(stats)
+    {
+        *link = stats->ss_Next;
+        PoolFree(&etherUnit->eu_TrackPool, stats);
+    }
+    else
     {
         ios2->ios2_Req.io_Error = S2ERR_BAD_STATE;
         ios2->ios2_WireError = S2WERR_NOT_TRACKED;
@@ -1770,7 +2465,42 @@ VOID DevCmdUnTrackType(STDETHERARGS)
 
     TermIO(ios2,globEtherDevice);
 }
+///
+
+///VOID DevCmdGetTypeStats(STDETHERARGS)
+/*
+** This function returns the statistics of a tracked packet type.
+*/
+VOID DevCmdGetTypeStats(STDETHERARGS)
+{
+    struct Sana2PacketTypeStats * Stat = ios2->ios2_StatData;
+    struct SuperS2PTStats * stats;
+
+    DEBUGOUT((VERBOSE_DEVICE,"*DevCmdGetTypeStats\n"));
+
+    if (Stat)
+    {
+        ObtainSemaphore((APTR)&etherUnit->eu_TrackLock);
+        stats = getTypeStats(etherUnit, ios2->ios2_PacketType);
+        if (stats)
+        {
+            *Stat = stats->ss_Stats;
+        }
+        else
+        {
+            ios2->ios2_Req.io_Error = S2ERR_BAD_STATE;
+            ios2->ios2_WireError = S2WERR_NOT_TRACKED;
+        }
+        ReleaseSemaphore((APTR)&etherUnit->eu_TrackLock);
+    }
+    else
+    {
+        ios2->ios2_Req.io_Error = S2ERR_BAD_ARGUMENT;
+        ios2->ios2_WireError = S2WERR_NULL_POINTER;
+    }
 
+    TermIO(ios2,globEtherDevice);
+}
 ///
 
 ///void DevCmdGlobStats(STDETHERARGS)
@@ -1783,12 +2513,13 @@ void DevCmdGlobStats(STDETHERARGS)
    // gibts den Zeiger auch wirklich ?
    if (Stat)
    {
+      //Counted by the lowleveldriver: bad frames and overruns never reach the device
       Stat->PacketsReceived      = GlobStat.PacketsReceived;
       Stat->PacketsSent          = GlobStat.PacketsSent;
-      Stat->BadData              = 0;
-      Stat->Overruns             = 0;
+      Stat->BadData              = etherUnit->eu_lowLevelDriver->rxBadFrames;
+      Stat->Overruns             = etherUnit->eu_lowLevelDriver->rxOverruns;
       Stat->UnknownTypesReceived = GlobStat.UnknownTypesReceived;
-      Stat->Reconfigurations     = 0;
+      Stat->Reconfigurations     = GlobStat.Reconfigurations;
       
       Stat->LastStart.tv_secs    = GlobStat.LastStart.tv_secs;  
       Stat->LastStart.tv_micro   = GlobStat.LastStart.tv_micro;  
@@ -1829,57 +2560,53 @@ VOID DevCmdOnEvent(STDETHERARGS)
     Permit();
 }
 
-void getmcaf(struct DeviceDriver *EtherDevice, ULONG * af)      
+/**
+ * Finds a multicast address in the list of used multicast addresses (ed_MCAF_Lock must be held)
+ * @param address
+ * @return list entry or NULL
+ */
+static struct MCAF_Address * findMulticastAddress(const UBYTE * address)
 {
-   register UBYTE *cp, c;
-   register ULONG crc;
-   register int i, len;
    struct MCAF_Address * ActNode;
 
-   // * Set up multicast address filter by passing all multicast addresses
-   // * through a crc generator, and then using the high order 6 bits as an
-   // * index into the 64 bit logical address filter.  The high order bit
-   // * selects the word, while the rest of the bits select the bit within
-   // * the word.
+   for (ActNode = GET_FIRST(globEtherDevice->ed_MCAF); IS_VALID(ActNode); ActNode = GET_NEXT(ActNode)) {
+      if (0 == memcmp(ActNode->MCAF_Adr, address, sizeof(ActNode->MCAF_Adr))) {
+         return ActNode;
+      }
+   }
+   return NULL;
+}
 
+/**
+ * Programs the multicast filter of the NIC with the used multicast addresses (ed_MCAF_Lock must be held).
+ * With more addresses than the hash filter takes, the NIC receives all multicast frames. Either way the
+ * receive path drops the frames of the addresses nobody added (see isWantedMulticast).
+ * @param etherUnit
+ */
+static void updateMulticastFilter(struct DeviceDriverUnit * etherUnit)
+{
+   NetInterface * lowLevelDriver = etherUnit->eu_lowLevelDriver;
+   struct MCAF_Address * ActNode;
+   uint8_t entries = 0;
 
-   if (EtherDevice->ed_Device.lib_Flags & ETHERUF_PROMISC) {      
-      af[0] = af[1] = 0xffffffff;
+   if (globEtherDevice->ed_MCAF_Count > MAC_MULTICAST_FILTER_SIZE) {
+      DEBUGOUT((VERBOSE_DEVICE, "%ld multicast addresses: receiving all multicast frames\n",
+            (ULONG)globEtherDevice->ed_MCAF_Count));
+      lowLevelDriver->setMulticastFilter(lowLevelDriver, NULL, 0);
       return;
    }
 
-   ObtainSemaphore((APTR)&EtherDevice->ed_MCAF_Lock);
-   af[0] = af[1] = 0;
-   ActNode = GET_FIRST(EtherDevice->ed_MCAF);   
-   while (IS_VALID(ActNode)) {
-
-      cp = ActNode->MCAF_Adr;
-      crc = 0xffffffff;
-      for (len = sizeof(ActNode->MCAF_Adr); --len >= 0;) {
-         c = *cp++;
-         for (i = 8; --i >= 0;) {
-            if (((crc & 0x80000000) ? 1 : 0) ^ (c & 0x01)) {
-               crc <<= 1;
-               crc ^= 0x04c11db6 | 1;
-            } else
-               crc <<= 1;
-            c >>= 1;
-         }
-      }
-      // Just want the 6 most significant bits.
-      crc >>= 26;
-
-      // Turn on the corresponding bit in the filter.
-      af[crc >> 5] |= 1 << ((crc & 0x1f) ^ 24);
-
-      ActNode = GET_NEXT(ActNode);
-   }  
-   ReleaseSemaphore((APTR)&EtherDevice->ed_MCAF_Lock);
+   for (ActNode = GET_FIRST(globEtherDevice->ed_MCAF); IS_VALID(ActNode); ActNode = GET_NEXT(ActNode)) {
+      copyEthernetAddress(ActNode->MCAF_Adr, lowLevelDriver->macMulticastFilter[entries].addr.b);
+      lowLevelDriver->macMulticastFilter[entries].refCount = ActNode->MCAF_UseCount;
+      entries++;
+   }
+   lowLevelDriver->setMulticastFilter(lowLevelDriver, lowLevelDriver->macMulticastFilter, entries);
 }
-///
 
 /**
- * Device command. Adds a new mutlicast address to the device driver...
+ * Device command S2_ADDMULTICASTADDRESS. Adds a multicast address (ios2_SrcAddr) to the addresses the
+ * device receives. Every add must be followed by a S2_DELMULTICASTADDRESS (use count).
  * @param STDETHERARGS
  * @param STDETHERARGS
  * @param STDETHERARGS
@@ -1887,94 +2614,72 @@ void getmcaf(struct DeviceDriver *EtherDevice, ULONG * af)
 VOID DevCmdAddMulti(STDETHERARGS)
 {
    struct MCAF_Address * NewMCAF;
-   struct MCAF_Address * ActNode;
 
    print(VERBOSE_DEVICE,"*AddMulticast\n");
+   PRINT_ETHERNET_ADDRESS(ios2->ios2_SrcAddr);
+
+   if (!(ios2->ios2_SrcAddr[0] & 0x01)) {
+      ios2->ios2_Req.io_Error = S2ERR_BAD_ADDRESS;
+      ios2->ios2_WireError = S2WERR_BAD_MULTICAST;
+      TermIO(ios2,globEtherDevice);
+      return;
+   }
 
    ObtainSemaphore((APTR)&globEtherDevice->ed_MCAF_Lock);
 
-   //Check if address already exists
-   ActNode = GET_FIRST(globEtherDevice->ed_MCAF);
-   while(IS_VALID(ActNode))
-   { 
-      if (0 == memcmp( ActNode->MCAF_Adr, ios2->ios2_SrcAddr, 6))
-      {
-         //Address already exists. End.
+   //Address already used: only count
+   NewMCAF = findMulticastAddress(ios2->ios2_SrcAddr);
+   if (NewMCAF) {
+      NewMCAF->MCAF_UseCount++;
+      TermIO(ios2,globEtherDevice);
+   } else {
+      //Create a new entry and add it to the list of used mulicast addresses
+      NewMCAF = PoolAlloc(&etherUnit->eu_MulticastPool);
+      if (NewMCAF) {
+         copyEthernetAddress(ios2->ios2_SrcAddr, NewMCAF->MCAF_Adr);
+         NewMCAF->MCAF_UseCount = 1;
+         AddHead((APTR)&globEtherDevice->ed_MCAF,(APTR)NewMCAF);
+         globEtherDevice->ed_MCAF_Count++;
+         updateMulticastFilter(etherUnit);
+         TermIO(ios2,globEtherDevice);
+      } else {
+         ios2->ios2_Req.io_Error = S2ERR_NO_RESOURCES;
+         ios2->ios2_WireError = S2WERR_GENERIC_ERROR;
          TermIO(ios2,globEtherDevice);
-         goto end;
       }
-      ActNode = GET_NEXT(ActNode);
    }
 
-   //Create a new entry and add it to the list of used mulicast addresses
-   NewMCAF = (APTR)AllocMem(sizeof(struct MCAF_Address), MEMF_ANY);
-   if (NewMCAF)
-   { 
-      copyEthernetAddress( ios2->ios2_SrcAddr, NewMCAF->MCAF_Adr);
-   
-      AddHead((APTR)&globEtherDevice->ed_MCAF,(APTR)NewMCAF);
-      print(VERBOSE_DEVICE," new multicast address :\n");
-      PRINT_ETHERNET_ADDRESS(NewMCAF->MCAF_Adr);
-      TermIO(ios2,globEtherDevice);
-      
-      //TODO: hardware access
-   }
-   else      
-   {
-      ios2->ios2_Req.io_Error = S2ERR_SOFTWARE;
-      ios2->ios2_WireError = S2WERR_GENERIC_ERROR;
-      TermIO(ios2,globEtherDevice);
-   }
-
-   end:
    ReleaseSemaphore((APTR)&globEtherDevice->ed_MCAF_Lock);
 }
 
-///VOID DevCmdRemMulti(STDETHERARGS)
+/**
+ * Device command S2_DELMULTICASTADDRESS. Counterpart of S2_ADDMULTICASTADDRESS: When the last user
+ * deletes the multicast address (ios2_SrcAddr), the device doesn't receive it anymore.
+ * @param STDETHERARGS
+ * @param STDETHERARGS
+ * @param STDETHERARGS
+ */
 VOID DevCmdRemMulti(STDETHERARGS)
 {
-   bool found = FALSE;
    struct MCAF_Address * ActNode;
-   int i;
-
-   ObtainSemaphore((APTR)&globEtherDevice->ed_MCAF_Lock);
 
-   ActNode = (struct MCAF_Address * )GET_FIRST(globEtherDevice->ed_MCAF);
    print(VERBOSE_DEVICE,"*DelMulticast\n");
-   while(IS_VALID(ActNode))
-   {
-      print(VERBOSE_DEVICE," gefundene Multicastadresse :\n");
-      for(i=0;i<6;i++)
-      {
-         printi(5,ActNode->MCAF_Adr[i]);
-      }
+   PRINT_ETHERNET_ADDRESS(ios2->ios2_SrcAddr);
 
-      // ist das unsere Adresse ?
-      if (memcmp( ActNode->MCAF_Adr, ios2->ios2_SrcAddr, 6)==0)
-      {
-         //gefunden!
-         Remove((APTR)ActNode);
-         FreeMem(ActNode, sizeof(struct MCAF_Address));
-         print(VERBOSE_DEVICE," MulticastAdresse wieder entfernt!\n");
-         TermIO(ios2,globEtherDevice);               
-         found = TRUE;
-         break;
-      }
-      
-      ActNode = GET_NEXT(ActNode);
-   }
-   
-   if (!found)
-   {
-        print(VERBOSE_DEVICE," MulticastAdresse wurde NICHT gefunden !!!\n");
-        ios2->ios2_Req.io_Error = S2ERR_BAD_ADDRESS;
-        ios2->ios2_WireError = S2WERR_BAD_MULTICAST;
-        TermIO(ios2,globEtherDevice);
-   }
-   else
-   {
-      //TODO: Deactivate multicast address
+   ObtainSemaphore((APTR)&globEtherDevice->ed_MCAF_Lock);
+
+   ActNode = findMulticastAddress(ios2->ios2_SrcAddr);
+   if (ActNode == NULL) {
+      print(VERBOSE_DEVICE," multicast address not found!\n");
+      ios2->ios2_Req.io_Error = S2ERR_BAD_ADDRESS;
+      ios2->ios2_WireError = S2WERR_BAD_MULTICAST;
+   } else if (--ActNode->MCAF_UseCount == 0) {
+      Remove((APTR)ActNode);
+      PoolFree(&etherUnit->eu_MulticastPool, ActNode);
+      globEtherDevice->ed_MCAF_Count--;
+      updateMulticastFilter(etherUnit);
    }
+   TermIO(ios2,globEtherDevice);
 
    ReleaseSemaphore((APTR)&globEtherDevice->ed_MCAF_Lock);
 }
@@ -2012,8 +2717,14 @@ static BOOL DevAddSpecialStat(struct Sana2SpecialStatHeader * statistics, int ty
 
 void DevCmdGetSpecialStats(STDETHERARGS)
 {
+   //Names of eu_TxBatches
+   static char * const txBatchStatNames[TX_BATCH_FRAMES] = {
+      "TX batches of 1 packet",  "TX batches of 2 packets", "TX batches of 3 packets", "TX batches of 4 packets",
+      "TX batches of 5 packets", "TX batches of 6 packets", "TX batches of 7 packets", "TX batches of 8 packets"
+   };
    struct Sana2SpecialStatHeader * Stat = ios2->ios2_StatData;
    int statType = 1;
+   int i;
 
    DEBUGOUT((VERBOSE_DEVICE, "*DevCmdGetSpecialStats(max=%ld)\n", Stat ? Stat->RecordCountMax : -1));
 
@@ -2021,8 +2732,52 @@ void DevCmdGetSpecialStats(STDETHERARGS)
       //Beginning with zero statistics. All entries are added one by one...
       Stat->RecordCountSupplied = 0;
 
-      DevAddSpecialStat(Stat, statType++, "Test Statistic", 0);
-      //TODO...
+      NetInterface * lowLevelDriver = etherUnit->eu_lowLevelDriver;
+
+      //Checksum offload (config CHECKSUMOFFLOAD) and the received frames the NIC dropped because of it
+      DevAddSpecialStat(Stat, statType++, "Checksum offload IP/TCP/UDP/ICMP", lowLevelDriver->checksumOffload);
+      DevAddSpecialStat(Stat, statType++, "IP checksum errors",   lowLevelDriver->rxChecksumErrors[NET_CHECKSUM_IP]);
+      DevAddSpecialStat(Stat, statType++, "TCP checksum errors",  lowLevelDriver->rxChecksumErrors[NET_CHECKSUM_TCP]);
+      DevAddSpecialStat(Stat, statType++, "UDP checksum errors",  lowLevelDriver->rxChecksumErrors[NET_CHECKSUM_UDP]);
+      DevAddSpecialStat(Stat, statType++, "ICMP checksum errors", lowLevelDriver->rxChecksumErrors[NET_CHECKSUM_ICMP]);
+
+      //RX polling under load (config RXPOLLBUDGET)
+      DevAddSpecialStat(Stat, statType++, "RX poll budget (frames)",    lowLevelDriver->rxPollBudget);
+      DevAddSpecialStat(Stat, statType++, "RX polls",                   lowLevelDriver->rxPolls);
+      DevAddSpecialStat(Stat, statType++, "RX switches to polling",     lowLevelDriver->rxPollSwitches);
+
+      //Send mode (config TXMODE) and the sizes of the sent batches
+      DevAddSpecialStat(Stat, statType++, "TX mode (0: caller task, 1: unit process)", etherUnit->eu_TxMode);
+      for (i = 0; i < TX_BATCH_FRAMES; i++) {
+         DevAddSpecialStat(Stat, statType++, txBatchStatNames[i], etherUnit->eu_TxBatches[i]);
+      }
+
+      //Park pool (config RXPARKSLOTS)
+      DevAddSpecialStat(Stat, statType++, "Park pool slots",     etherUnit->eu_RxParkSlots);
+      DevAddSpecialStat(Stat, statType++, "Park pool hits",      etherUnit->eu_RxParkHits);
+      DevAddSpecialStat(Stat, statType++, "Park pool misses",    etherUnit->eu_RxParkMisses);
+      DevAddSpecialStat(Stat, statType++, "Park pool evictions", etherUnit->eu_RxParkEvictions);
+
+      //Used objects of the pools (config POOLOPENERS, POOLTRACKTYPES, POOLMULTICAST)
+      DevAddSpecialStat(Stat, statType++, "Opener pool used",            etherUnit->eu_OpenerPool.fp_Used);
+      DevAddSpecialStat(Stat, statType++, "Opener pool size",            etherUnit->eu_OpenerPool.fp_Objects);
+      DevAddSpecialStat(Stat, statType++, "Tracked type pool used",      etherUnit->eu_TrackPool.fp_Used);
+      DevAddSpecialStat(Stat, statType++, "Tracked type pool size",      etherUnit->eu_TrackPool.fp_Objects);
+      DevAddSpecialStat(Stat, statType++, "Multicast pool used",         etherUnit->eu_MulticastPool.fp_Used);
+      DevAddSpecialStat(Stat, statType++, "Multicast pool size",         etherUnit->eu_MulticastPool.fp_Objects);
+      DevAddSpecialStat(Stat, statType++, "Pool allocation failures",    etherUnit->eu_OpenerPool.fp_Failures
+            + etherUnit->eu_TrackPool.fp_Failures + etherUnit->eu_MulticastPool.fp_Failures);
+
+      //Receive statistics of the opener that asks (too many empty queue drops: the stack queues too few reads)
+      struct BufferManagement * bm = ios2->ios2_BufferManagement;
+      if (bm) {
+         DevAddSpecialStat(Stat, statType++, "Opener packets received",      bm->bm_Stats.bs_FramesReceived);
+         DevAddSpecialStat(Stat, statType++, "Opener bytes received",        bm->bm_Stats.bs_BytesReceived);
+         DevAddSpecialStat(Stat, statType++, "Opener filter hook rejects",   bm->bm_Stats.bs_FilterRejects);
+         DevAddSpecialStat(Stat, statType++, "Opener copy failures",         bm->bm_Stats.bs_CopyFailures);
+         DevAddSpecialStat(Stat, statType++, "Opener empty read queue drops", bm->bm_Stats.bs_EmptyQueueDrops);
+         DevAddSpecialStat(Stat, statType++, "Opener read queue high water", bm->bm_Stats.bs_ReadsHighWater);
+      }
    }
    else
    {
@@ -2046,13 +2801,13 @@ static UWORD auwSupportCmds[]={CMD_READ,
                                S2_DEVICEQUERY,
                                S2_GETSTATIONADDRESS,
                                S2_CONFIGINTERFACE,
-                               //S2_ADDMULTICASTADDRESS,
-                               //S2_DELMULTICASTADDRESS,
+                               S2_ADDMULTICASTADDRESS,
+                               S2_DELMULTICASTADDRESS,
                                S2_MULTICAST,
                                S2_BROADCAST,
                                S2_TRACKTYPE,
                                S2_UNTRACKTYPE,
-                               //S2_GETTYPESTATS,
+                               S2_GETTYPESTATS,
                                S2_GETGLOBALSTATS,
                                S2_ONEVENT,
                                S2_READORPHAN,
@@ -2088,13 +2843,118 @@ VOID DevCmdNSDeviceQuery(STDETHERARGS)
     TermIO(ios2,globEtherDevice);
 }
 
-//Temp buffer to send packets which are of type "cooked" only...
-static uint8_t sendBuffer[2000];
+//A packet of a TX batch, described for the low level driver
+struct TxBatchEntry
+{
+   NetTxSegment segments[4];  //Cooked: destination, source, type and payload. Raw: the whole packet
+   UWORD packetType;          //Packet type of a cooked packet (big endian CPU: network byte order)
+};
 
 
 /**
- * Writing Packets. Check if packets should be send out.
- * Returns TRUE if something was send. False if not...
+ * Describes the packet of a write request as a frame for the low level driver. The Ethernet header of
+ * a cooked packet is taken from the request and the unit, the packet data directly from the stack's
+ * buffer (SANA2 V3 DMA extension) or copied into "buffer".
+ *
+ * @param etherUnit
+ * @param ios2 write request
+ * @param frame frame to fill
+ * @param entry segments of the frame
+ * @param buffer temp buffer for the packet data
+ * @return FALSE if the request failed (error is set in the request)
+ */
+static BOOL prepareTxFrame(struct DeviceDriverUnit *etherUnit, struct IOSana2Req *ios2, NetTxFrame * frame,
+      struct TxBatchEntry * entry, uint8_t * buffer) {
+
+   struct BufferManagement *bm = (struct BufferManagement *) ios2->ios2_BufferManagement;
+   NetTxSegment * data;
+
+   //Check if the stack tells us it's packet buffer (SANA2 V3 extension)
+   APTR dmaPacketBuffer = (bm->bm_CopyFromBufferDMA != 0l) ? CopyFromBufferDMA(ios2->ios2_Data) : NULL;
+
+   //Raw or Cooked packet?
+   if (ios2->ios2_Req.io_Flags & SANA2IOF_RAW) {
+      //
+      // RAW:
+      //
+      TRACE_INFO("  Send raw packet:\n");
+
+      if (ios2->ios2_DataLength <= ETHER_PACKET_HEAD_SIZE) {
+         setErrorOnRequest(ios2, S2ERR_MTU_EXCEEDED, S2WERR_BUFF_ERROR);
+         return FALSE;
+      }
+      frame->segments     = entry->segments;
+      frame->segmentCount = 1;
+      data = &entry->segments[0];
+
+   } else {
+      //
+      // COOKED:
+      //
+      if (ios2->ios2_DataLength > ETHERNET_MTU) {
+         setErrorOnRequest(ios2, S2ERR_MTU_EXCEEDED, S2WERR_BUFF_ERROR);
+         DEBUGOUT((VERBOSE_HW, "   Pkt exceeds the MTU!\n"));
+         return FALSE;
+      }
+
+      DEBUGOUT((VERBOSE_HW, "  Send cooked packet:\n"));
+      DEBUGOUT((VERBOSE_HW, "    NetIORequest    : 0x%lx\n", ios2));
+      if (ios2->ios2_DataLength < 46) {
+         DEBUGOUT((VERBOSE_HW, "      Pkt < 46 bytes payload (%ld bytes)\n", ios2->ios2_DataLength));
+      }
+      DEBUGOUT((VERBOSE_HW, "      DstAddr         : ")); printEthernetAddress(ios2->ios2_DstAddr);   DEBUGOUT((VERBOSE_HW,"\n"));
+      DEBUGOUT((VERBOSE_HW, "      SrcAddr         : ")); printEthernetAddress(etherUnit->eu_StAddr); DEBUGOUT((VERBOSE_HW,"\n"));
+      DEBUGOUT((VERBOSE_HW, "      PacketType      : 0x%lx\n", (ULONG)ios2->ios2_PacketType));
+      DEBUGOUT((VERBOSE_HW, "      DataLength      : 0x%lx\n", (ULONG)ios2->ios2_DataLength));
+      DEBUGOUT((VERBOSE_HW, "      DMABufferPtr    : 0x%lx\n", (ULONG)dmaPacketBuffer));
+
+      //Ethernet header: SRC + DST + Type, streamed by the low level driver without a temp buffer
+      entry->packetType = (UWORD)ios2->ios2_PacketType;
+      entry->segments[0].data   = ios2->ios2_DstAddr;
+      entry->segments[0].length = 6;
+      entry->segments[1].data   = etherUnit->eu_StAddr;
+      entry->segments[1].length = 6;
+      entry->segments[2].data   = (uint8_t *)&entry->packetType;
+      entry->segments[2].length = 2;
+      frame->segments     = entry->segments;
+      frame->segmentCount = 4;
+      data = &entry->segments[3];
+   }
+
+   //Test: Stop using DMA!!!!
+   //dmaPacketBuffer = NULL;
+
+   if (dmaPacketBuffer) {
+      //Yes, use SANA2 V3 extension: Direct copy without any second buffer...
+      data->data = dmaPacketBuffer;
+   } else {
+      //No, go ahead with old V2 copy functions (let stack copy the data)
+      if (!CopyFromBuffer((APTR)buffer, ios2->ios2_Data, ios2->ios2_DataLength)) {
+         setErrorOnRequest(ios2, S2ERR_NO_RESOURCES, S2WERR_BUFF_ERROR);
+         DEBUGOUT((VERBOSE_HW, "   CopyFromBuffer error\n"));
+         return FALSE;
+      }
+      data->data = buffer;
+   }
+   data->length = ios2->ios2_DataLength;
+   dumpMem((uint8_t *)data->data, data->length);
+
+   return TRUE;
+}
+
+/**
+ * Replies a processed write request.
+ */
+static void replyTxRequest(struct DeviceDriverUnit *etherUnit, struct DeviceDriver *etherDevice, struct IOSana2Req *ios2) {
+   if (ios2->ios2_WireError != 0) {
+      DoEvent(S2EVENT_BUFF, etherUnit, etherDevice);
+   }
+   TermIO(ios2, etherDevice);
+}
+
+/**
+ * Writing Packets. Sends all pending write requests in batches of up to TX_BATCH_FRAMES
+ * packets: Each batch is written into the TX FIFO with one register preamble.
  *
  * @param etherUnit
  * @param etherDevice
@@ -2102,112 +2962,85 @@ static uint8_t sendBuffer[2000];
  */
 static void sendAllPackets(struct DeviceDriverUnit *etherUnit, struct DeviceDriver *etherDevice) {
 
+   struct IOSana2Req *batch[TX_BATCH_FRAMES];
+   struct TxBatchEntry entries[TX_BATCH_FRAMES];
+   NetTxFrame frames[TX_BATCH_FRAMES];
+   NetInterface * lowLevelDriver = etherUnit->eu_lowLevelDriver;
    struct IOSana2Req *ios2;
-   struct BufferManagement *bm;
+   uint16_t count;
+   uint16_t sent;
+   uint16_t i;
 
    DEBUGOUT((VERBOSE_HW, "serviceWritePackets():\n"));
 
-   // Send all packets which are in queue...
-   while ((ios2 = (struct IOSana2Req *)GetMsg((APTR)etherUnit->eu_Tx)) != NULL) {
+   //Keeps the packets in order (caller's task vs. unit process)
+   ObtainSemaphore(&etherUnit->eu_TxLock);
 
-      bm = (struct BufferManagement *) ios2->ios2_BufferManagement;
-
-      //Check if the stack tells us it's packet buffer (SANA2 V3 extension)
-      APTR dmaPacketBuffer = (bm->bm_CopyFromBufferDMA != 0l) ? CopyFromBufferDMA(ios2->ios2_Data) : NULL;
-
-      //Raw or Cooked packet?
-      if (ios2->ios2_Req.io_Flags & SANA2IOF_RAW) {
-         //
-         // RAW:
-         //
-         TRACE_INFO("  Send raw packet:\n");
-
-         if (ios2->ios2_DataLength > ETHER_PACKET_HEAD_SIZE) {
-            if (CopyFromBuffer((APTR)sendBuffer,ios2->ios2_Data, ios2->ios2_DataLength)) {
-               dumpMem(sendBuffer, ios2->ios2_DataLength);
-               etherUnit->eu_lowLevelDriver->sendPacket(etherUnit->eu_lowLevelDriver, sendBuffer, ios2->ios2_DataLength);
-            } else {
-               setErrorOnRequest(ios2, S2ERR_NO_RESOURCES, S2WERR_BUFF_ERROR);
-            }
+   // Send all packets which are in queue...
+   do {
+      //Collect the next batch
+      count = 0;
+      while (count < TX_BATCH_FRAMES && (ios2 = (struct IOSana2Req *)GetMsg((APTR)etherUnit->eu_Tx)) != NULL) {
+         if (prepareTxFrame(etherUnit, ios2, &frames[count], &entries[count], etherUnit->eu_TxBuffer[count])) {
+            batch[count++] = ios2;
          } else {
-            setErrorOnRequest(ios2, S2ERR_MTU_EXCEEDED, S2WERR_BUFF_ERROR);
+            replyTxRequest(etherUnit, etherDevice, ios2);
          }
+      }
+      if (count == 0) {
+         break;
+      }
 
-      } else {
-         //
-         // COOKED:
-         //
-         if (ios2->ios2_DataLength <= ETHERNET_MTU) {
-
-            DEBUGOUT((VERBOSE_HW, "  Send cooked packet:\n"));
-            DEBUGOUT((VERBOSE_HW, "    NetIORequest    : 0x%lx\n", ios2));
-            if (ios2->ios2_DataLength < 46) {
-               DEBUGOUT((VERBOSE_HW, "      Pkt < 46 bytes payload (%ld bytes)\n", ios2->ios2_DataLength));
-            }
-            DEBUGOUT((VERBOSE_HW, "      DstAddr         : ")); printEthernetAddress(ios2->ios2_DstAddr);   DEBUGOUT((VERBOSE_HW,"\n"));
-            DEBUGOUT((VERBOSE_HW, "      SrcAddr         : ")); printEthernetAddress(etherUnit->eu_StAddr); DEBUGOUT((VERBOSE_HW,"\n"));
-            DEBUGOUT((VERBOSE_HW, "      PacketType      : 0x%lx\n", (ULONG)ios2->ios2_PacketType));
-            DEBUGOUT((VERBOSE_HW, "      DataLength      : 0x%lx\n", (ULONG)ios2->ios2_DataLength));
-            DEBUGOUT((VERBOSE_HW, "      DMABufferPtr    : 0x%lx\n", (ULONG)dmaPacketBuffer));
-
-            //Test: Stop using DMA!!!!
-            //dmaPacketBuffer = NULL;
-
-            if (dmaPacketBuffer) {
-               //Yes, use SANA2 V3 extension: Direct copy without any second buffer...
-               dumpMem(dmaPacketBuffer, ios2->ios2_DataLength);
-               etherUnit->eu_lowLevelDriver->sendPacketCooked(etherUnit->eu_lowLevelDriver,
-                     (MacAddr*)ios2->ios2_DstAddr,
-                     (MacAddr*)etherUnit->eu_StAddr,
-                     (uint16_t)ios2->ios2_PacketType,
-                     dmaPacketBuffer,
-                     ios2->ios2_DataLength);
-
-            } else {
-               //No, go ahead with old V2 copy functions (let stack copy the data)
-
-               //Build a raw ethernet packet (with a temp buffer): SRC + DST + Type:
-               copyEthernetAddress(ios2->ios2_DstAddr,   sendBuffer+0);
-               copyEthernetAddress(etherUnit->eu_StAddr, sendBuffer+6);
-               *(uint16_t*)(sendBuffer+12) = ios2->ios2_PacketType;
-
-               //copy packet data from request at offset ETHER_PACKET_HEAD_SIZE as the ethernet content:
-               if (CopyFromBuffer((APTR)(sendBuffer + ETHER_PACKET_HEAD_SIZE), ios2->ios2_Data, ios2->ios2_DataLength)) {
-
-                  /*
-                  //Send packet (old send method working):
-                  //respect minimal size of 46 bytes Ethernet Frame
-                  int len = (ios2->ios2_DataLength < 46) ? 46 : ios2->ios2_DataLength;
-                  len += ETHER_PACKET_HEAD_SIZE;
-                  dumpMem(sendBuffer, len);
-                  etherUnit->eu_lowLevelDriver->sendPacket(etherUnit->eu_lowLevelDriver, sendBuffer, len);
-                  */
-
-                  //New method:
-                  dumpMem(sendBuffer, ios2->ios2_DataLength + ETHER_PACKET_HEAD_SIZE);
-                  etherUnit->eu_lowLevelDriver->sendPacketCooked(etherUnit->eu_lowLevelDriver,
-                        (MacAddr*)(sendBuffer+0),
-                        (MacAddr*)(sendBuffer+6),
-                        *(uint16_t*)(sendBuffer+12),
-                        (sendBuffer+ETHER_PACKET_HEAD_SIZE),
-                        ios2->ios2_DataLength);
-
-               } else {
-                  setErrorOnRequest(ios2, S2ERR_NO_RESOURCES, S2WERR_BUFF_ERROR);
-                  DEBUGOUT((VERBOSE_HW, "   CopyFromBuffer error\n"));
-               }
-            }
+      sent = lowLevelDriver->sendPackets(lowLevelDriver, frames, count);
+      DEBUGOUT((VERBOSE_HW, "  Batch of %ld packets, %ld processed\n", (ULONG)count, (ULONG)sent));
+      //Only the packets the TX FIFO took, the deferred rest is counted with its retry
+      if (sent > 0) {
+         etherUnit->eu_TxBatches[sent - 1]++;
+      }
+
+      for (i = 0; i < sent; i++) {
+         if (frames[i].error != NO_ERROR) {
+            setErrorOnRequest(batch[i], S2ERR_MTU_EXCEEDED, S2WERR_BUFF_ERROR);
          } else {
-            setErrorOnRequest(ios2, S2ERR_MTU_EXCEEDED, S2WERR_BUFF_ERROR);
-            DEBUGOUT((VERBOSE_HW, "   Pkt exceeds the MTU!\n"));
+            GlobStat.PacketsSent++;
+            countTypeStats(etherUnit, batch[i]->ios2_PacketType, TYPE_STAT_SENT, batch[i]->ios2_DataLength);
          }
+         replyTxRequest(etherUnit, etherDevice, batch[i]);
       }
-      //end:
-      if (ios2->ios2_WireError != 0) {
-         DoEvent(S2EVENT_BUFF, etherUnit, etherDevice);
+
+      //The TX FIFO is full: The packets behind "sent" stay queued (in order) until the low level
+      //driver reports space again (onTxSpaceAvailable)
+      if (sent < count) {
+         DEBUGOUT((VERBOSE_HW, "  TX FIFO full, %ld packets deferred\n", (ULONG)(count - sent)));
+         Forbid();
+         for (i = count; i > sent; i--) {
+            AddHead(&etherUnit->eu_Tx->mp_MsgList, (struct Node *)batch[i - 1]);
+         }
+         Permit();
+         break;
       }
-      TermIO(ios2, etherDevice);
+   } while (count == TX_BATCH_FRAMES);
+
+   ReleaseSemaphore(&etherUnit->eu_TxLock);
+}
+
+/**
+ * Callback of the low level driver (unit process or bottom half): The TX FIFO has space again for the deferred
+ * packets.
+ * @param interface
+ */
+static void onTxSpaceAvailable(NetInterface * interface) {
+   struct DeviceDriverUnit * etherUnit = UNIT_OF(interface);
+
+   DEBUGOUT((VERBOSE_HW, "onTxSpaceAvailable()\n"));
+
+   //The bottom half can't wait for the TX lock: the unit process sends the packets
+   if (etherUnit->eu_InBottomHalf) {
+      etherUnit->eu_TxSpacePending = TRUE;
+      Signal(&etherUnit->eu_Proc->pr_Task, 1L << etherUnit->eu_lowLevelDriverSignalNumber);
+      return;
    }
+   sendAllPackets(etherUnit, globEtherDevice);
 }
 
 /**
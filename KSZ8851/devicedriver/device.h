@@ -35,6 +35,7 @@
 #include <stdbool.h>
 
 #include "copybuffs.h"
+#include "pool.h"
 #include "hardware-interface.h"
 
 
@@ -44,6 +45,17 @@
 //Priority of the device unit task
 #define UNIT_PROCESS_PRIORITY 0
 
+//Maximum number of write requests that are written into the TX FIFO with one register preamble
+#define TX_BATCH_FRAMES 8
+//Size of a packet copy (raw packet: Ethernet header + MTU)
+#define TX_BUFFER_SIZE (14 + 1500)
+
+//Who sends the write requests (config TXMODE)
+#define TX_MODE_CALLER 0   // The task of the stack right in CMD_WRITE
+#define TX_MODE_UNIT   1   // The unit process: CMD_WRITE only queues the request and signals it (eu_Tx)
+//Size of a slot of the park pool (raw packet: Ethernet header + MTU)
+#define RX_PARK_FRAME_SIZE (14 + 1500)
+
 //Initialized Ethernet broadcast address
 #define ETHERNET_ADDRESS_SIZE 6
 extern const UBYTE BROADCAST_ADDRESS[ETHERNET_ADDRESS_SIZE];
@@ -65,9 +77,25 @@ void printEthernetAddress(unsigned char * addr );
 
 // --------------------------------- TYPES ------------------------------------------------------------------
 
+//Slots of the table of tracked packet types (S2_TRACKTYPE), a type is hashed into one slot
+#define TRACK_TYPE_SLOTS 16
+
+/**
+ * A slot of the park pool (config RXPARKSLOTS): A received packet waits here for the next read request of
+ * the opener whose read queue of the packet type was empty.
+ */
+struct RxParkedFrame
+{
+    struct BufferManagement *    rf_Owner;                 // Opener the packet waits for (NULL: slot free)
+    ULONG                        rf_Age;                   // Arrival number (the smallest one is the oldest)
+    UWORD                        rf_Size;                  // Packet length incl. Ethernet header
+    UWORD                        rf_Type;                  // Packet type
+    UBYTE                        rf_Data[RX_PARK_FRAME_SIZE];
+};
+
 struct SuperS2PTStats
 {
-    struct MinNode               ss_Node;
+    struct SuperS2PTStats *      ss_Next;                  // Next tracked type in the same slot
     ULONG                        ss_PType;
     struct Sana2PacketTypeStats  ss_Stats;
 };
@@ -91,11 +119,17 @@ struct DeviceDriverUnit
     struct MsgPort         *eu_Tx;           /* Pending CMD_WRITE's for the Device Unit Process input.
                                                 There is no semaphore lock (MessagePort).
                                                 Instead Forbid and Permit is used. */
+    struct SignalSemaphore eu_TxLock;        /* Held while the packets of eu_Tx are sent (keeps them in order,
+                                                packets that don't fit into the TX FIFO are put back at the head) */
+    UBYTE                  eu_TxBuffer[TX_BATCH_FRAMES][TX_BUFFER_SIZE]; /* Copies of the packets of a TX batch when
+                                                the stack has no S2_DMACopyFromBuff32 (protected by eu_TxLock) */
+    UBYTE                  eu_TxMode;        /* TX_MODE_CALLER or TX_MODE_UNIT (config TXMODE) */
+    ULONG                  eu_TxBatches[TX_BATCH_FRAMES]; /* Sent batches by number of packets (index 0: one packet) */
 
     struct MinList         eu_Events;        /* Pending S2_ONEVENT's: No Lock! Use Forbid() / Permit(). */
 
-    struct MinList         eu_Track;         /* List of packet types being tracked */
-    struct SignalSemaphore eu_TrackLock;     /* Lock for...*/
+    struct SuperS2PTStats *eu_Track[TRACK_TYPE_SLOTS]; /* Packet types being tracked (direct mapped, see getTypeStats) */
+    struct SignalSemaphore eu_TrackLock;     /* Lock for eu_Track */
 
     struct MinList         eu_BuffMgmt;      /* List of all Buffer Management Entries (clients) */
     struct SignalSemaphore eu_BuffMgmtLock;  /* Lock of the List of Buffer Management Entries */
@@ -104,10 +138,30 @@ struct DeviceDriverUnit
     struct SignalSemaphore eu_ReadOrphanLock;// Semaphore fuer die "ReadOrphanliste"
 
     struct Sana2DeviceStats eu_Stats;        /* Global device statistics */
-    struct SuperS2PTStats* eu_IPTrack;       /* For tracking IP packets */
+
+    struct IOSana2Req *    eu_RxDirect;      /* Read request whose packet is just read directly (DMA) into ... */
+    UBYTE *                eu_RxDirectData;  /* ...this buffer of the stack (S2_DMACopyToBuff32) */
+    BOOL                   eu_RxStarvationCounted; /* onPktHeader counted the bs_EmptyQueueDrops of the packet */
+
+    struct RxParkedFrame * eu_RxPark;        /* Park pool: packets for openers whose read queue was empty */
+    UWORD                  eu_RxParkSlots;   /* Slots of eu_RxPark (config RXPARKSLOTS, allocated at unit start) */
+    UWORD                  eu_RxParkPerOpener; /* Max. parked packets of one opener (config RXPARKPEROPENER) */
+    ULONG                  eu_RxParkAge;     /* Arrival number of the next parked packet */
+    ULONG                  eu_RxParkHits;    /* Parked packets handed over to a read request */
+    ULONG                  eu_RxParkMisses;  /* Parked packets dropped without a read (filter hook, flush, close) */
+    ULONG                  eu_RxParkEvictions; /* Parked packets dropped for a newer one (budget used up) */
+    struct SignalSemaphore eu_RxParkLock;    /* Lock for eu_RxPark */
+
+    struct FixedPool       eu_OpenerPool;    /* BufferManagement of the openers (config POOLOPENERS) */
+    struct FixedPool       eu_TrackPool;     /* SuperS2PTStats of the tracked types (config POOLTRACKTYPES) */
+    struct FixedPool       eu_MulticastPool; /* MCAF_Address of the used multicast addresses (config POOLMULTICAST) */
 
     NetInterface *         eu_lowLevelDriver; //Access to the low level hardware driver...
     ULONG                  eu_lowLevelDriverSignalNumber; //The signal number used for low level signaling...
+
+    struct Interrupt       eu_BottomHalf;    /* Software interrupt that processes the NIC events (config BOTTOMHALF) */
+    volatile BOOL          eu_InBottomHalf;  /* The receive callbacks run in eu_BottomHalf (no semaphores there) */
+    volatile BOOL          eu_TxSpacePending;/* The TX FIFO got space in the bottom half: the unit process sends */
 };
 
 
@@ -135,22 +189,49 @@ struct DeviceDriver
    struct Hook             ed_DummyPFHook;         // Default Dummy Hook (assembler function)
    struct MinList          ed_MCAF;                // List of used multicast addresses
    struct SignalSemaphore  ed_MCAF_Lock;           // Semaphore for MCAF list
+   UWORD                   ed_MCAF_Count;          // Number of entries in ed_MCAF
    struct SignalSemaphore  ed_DeviceLock;          // General List Lock. Used only when open or close device
 };
 
+//Number of packet type slots for pending CMD_READ requests per opener. Slot 0 holds all IEEE 802.3
+//requests (type <= 1500), the other types are hashed into the slots 1..BM_TYPE_SLOTS-1.
+#define BM_TYPE_SLOTS 16
+
+/**
+ * Receive statistics of one opener (reported by S2_GETSPECIALSTATS of the opener)
+ */
+struct BufferManagementStats
+{
+    ULONG bs_FramesReceived;    // Packets delivered into a read request of the opener
+    ULONG bs_BytesReceived;     // ...and their data bytes
+    ULONG bs_FilterRejects;     // Packets the packet filter hook skipped
+    ULONG bs_CopyFailures;      // Packets the CopyToBuffer function of the stack failed for
+    ULONG bs_EmptyQueueDrops;   // Packets of a type the opener reads (own type slot) but no read request was pending
+    UWORD bs_ReadsPending;      // CMD_READ requests in the queues of the opener
+    UWORD bs_ReadsHighWater;    // Maximum of bs_ReadsPending
+};
+
+//bm_Tag of an opener that is open
+#define BM_TAG_OPEN 0x42554646   // 'BUFF'
+
 /**
  * A Buffer Management Entry
  */
 struct BufferManagement
 {
     struct MinNode         bm_Node;
+    ULONG                  bm_Tag;                 // BM_TAG_OPEN from open until close (see DevCmdReadPacket)
     SANA2_CFB              bm_CopyFromBuffer;
     SANA2_CTB              bm_CopyToBuffer;
     APTR                   bm_CopyFromBufferDMA;
     APTR                   bm_CopyToBufferDMA;
     struct Hook          *  bm_PacketFilterHook;   // SANA-II V2 Callback Hook
-    struct MinList          bm_RxQueue;            // Pending CMD_READ Requests
-    struct SignalSemaphore  bm_RxQueueLock;        // Lock for this bm_RxQueue
+    struct MinList          bm_RxQueue;            // Pending CMD_READ Requests of types without an own slot
+    struct SignalSemaphore  bm_RxQueueLock;        // Lock for bm_RxQueue and all bm_TypeQueue's
+    struct MinList          bm_TypeQueue[BM_TYPE_SLOTS];     // Pending CMD_READ Requests by packet type (oldest first)
+    ULONG                   bm_TypeQueueType[BM_TYPE_SLOTS]; // Packet type that owns the slot (0: slot free)
+    struct BufferManagementStats bm_Stats;         // Receive statistics (bs_ReadsPending under bm_RxQueueLock)
+    UWORD                   bm_Parked;             // Packets of the opener in the park pool (under eu_RxParkLock)
 };
 
 // Stores a used multicast address
@@ -158,7 +239,7 @@ struct MCAF_Address
 {
     struct MinNode      MCAF_Node;
     UBYTE               MCAF_Adr[6];               // Multicast MAC address
-    UBYTE               MCAF_Unit;                 // Count of using
+    UWORD               MCAF_UseCount;             // S2_ADDMULTICASTADDRESS calls without S2_DELMULTICASTADDRESS
 };
 
 // --------------------------------- PROTOTYPES -------------------------------------------------------------
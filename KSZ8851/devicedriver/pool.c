@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2019 by Heiko Pruessing
+ * This software may be used and distributed according to the terms
+ * of the GNU General Public License, incorporated herein by reference.
+*/
+
+// This module contains the fixed size object pools of the driver (see pool.h).
+
+#include <exec/types.h>
+#include <exec/memory.h>
+#include <proto/exec.h>
+
+#include <string.h>
+
+#include "pool.h"
+
+BOOL PoolInit(struct FixedPool * pool, ULONG objectSize)
+{
+   UBYTE * object;
+   UWORD i;
+
+   InitSemaphore(&pool->fp_Lock);
+   pool->fp_ObjectSize = (objectSize + 3) & ~3;
+   pool->fp_Free       = NULL;
+   pool->fp_Used       = 0;
+   pool->fp_HighWater  = 0;
+   pool->fp_Failures   = 0;
+   pool->fp_Memory     = NULL;
+
+   if (pool->fp_Objects) {
+      pool->fp_Memory = AllocMem(pool->fp_ObjectSize * pool->fp_Objects, MEMF_CLEAR | MEMF_PUBLIC);
+      if (!pool->fp_Memory) {
+         pool->fp_Objects = 0;
+         return FALSE;
+      }
+
+      //Link all objects into the free list (first object first)
+      object = (UBYTE *) pool->fp_Memory + pool->fp_ObjectSize * pool->fp_Objects;
+      for (i = 0; i < pool->fp_Objects; i++) {
+         object -= pool->fp_ObjectSize;
+         *(APTR *) object = pool->fp_Free;
+         pool->fp_Free = object;
+      }
+   }
+   return TRUE;
+}
+
+void PoolDestroy(struct FixedPool * pool)
+{
+   if (pool->fp_Memory) {
+      FreeMem(pool->fp_Memory, pool->fp_ObjectSize * pool->fp_Objects);
+      pool->fp_Memory = NULL;
+   }
+   pool->fp_Free = NULL;
+   pool->fp_Used = 0;
+}
+
+BOOL PoolContains(const struct FixedPool * pool, APTR object)
+{
+   ULONG offset = (UBYTE *) object - (UBYTE *) pool->fp_Memory;
+
+   return pool->fp_Memory && (UBYTE *) object >= (UBYTE *) pool->fp_Memory
+         && offset < pool->fp_ObjectSize * pool->fp_Objects && offset % pool->fp_ObjectSize == 0;
+}
+
+APTR PoolAlloc(struct FixedPool * pool)
+{
+   APTR object;
+
+   ObtainSemaphore(&pool->fp_Lock);
+   object = pool->fp_Free;
+   if (object) {
+      pool->fp_Free = *(APTR *) object;
+      if (++pool->fp_Used > pool->fp_HighWater) {
+         pool->fp_HighWater = pool->fp_Used;
+      }
+   } else {
+      pool->fp_Failures++;
+   }
+   ReleaseSemaphore(&pool->fp_Lock);
+
+   if (object) {
+      memset(object, 0, pool->fp_ObjectSize);
+   }
+   return object;
+}
+
+void PoolFree(struct FixedPool * pool, APTR object)
+{
+   if (object) {
+      ObtainSemaphore(&pool->fp_Lock);
+      *(APTR *) object = pool->fp_Free;
+      pool->fp_Free = object;
+      pool->fp_Used--;
+      ReleaseSemaphore(&pool->fp_Lock);
+   }
+}
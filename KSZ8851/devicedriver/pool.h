@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2019 by Heiko Pruessing
+ * This software may be used and distributed according to the terms
+ * of the GNU General Public License, incorporated herein by reference.
+*/
+
+#ifndef __POOL__H__
+#define __POOL__H__
+
+#include <exec/types.h>
+#include <exec/semaphores.h>
+
+/**
+ * Fixed size object pool: All objects of one kind (buffer management, tracked packet type, multicast
+ * address) are allocated with one AllocMem at unit start. Allocating and freeing an object later only
+ * takes it from or puts it back into the free list of the pool: exec's allocator is not used and the
+ * memory is not fragmented while the driver runs.
+ */
+struct FixedPool
+{
+    struct SignalSemaphore fp_Lock;
+    APTR                   fp_Memory;     // All objects (NULL: not initialized)
+    APTR                   fp_Free;       // First free object, the first longword links the next one
+    ULONG                  fp_ObjectSize; // Object size (rounded up to a multiple of 4)
+    UWORD                  fp_Objects;    // Number of objects (set from the config file before PoolInit)
+    UWORD                  fp_Used;       // Allocated objects
+    UWORD                  fp_HighWater;  // Maximum of fp_Used
+    ULONG                  fp_Failures;   // Allocations while all objects were used
+};
+
+/**
+ * Allocates the objects of the pool (fp_Objects). Without objects the pool stays empty.
+ * @param pool
+ * @param objectSize
+ * @return FALSE if there was not enough memory
+ */
+BOOL PoolInit(struct FixedPool * pool, ULONG objectSize);
+
+/**
+ * Frees the memory of all objects. The objects must not be used anymore.
+ * @param pool
+ */
+void PoolDestroy(struct FixedPool * pool);
+
+/**
+ * Checks in constant time if the pointer is an object of the pool (allocated or not).
+ * @param pool
+ * @param object
+ * @return TRUE for an object of the pool
+ */
+BOOL PoolContains(const struct FixedPool * pool, APTR object);
+
+/**
+ * Takes an object (cleared) from the pool.
+ * @param pool
+ * @return object or NULL if all objects are used
+ */
+APTR PoolAlloc(struct FixedPool * pool);
+
+/**
+ * Puts an object (from PoolAlloc) back into the pool.
+ * @param pool
+ * @param object
+ */
+void PoolFree(struct FixedPool * pool, APTR object);
+
+#endif
@@ -5,7 +5,8 @@
 #ifndef _hardware_public_h
 #define _hardware_public_h
 
-//TODO: Right?
+//Max. multicast groups in the hash filter of the NIC. With more groups the NIC receives all multicast
+//frames (too many hash collisions), the upper layer filters them anyway.
 #define MAC_MULTICAST_FILTER_SIZE 10
 
 #define __start_packed
@@ -28,6 +29,7 @@
 #define ERROR_FAILURE -4
 #define ERROR_INVALID_PACKET -5
 #define NO_CHIP_FOUND -6
+#define ERROR_TX_QUEUE_FULL -7
 
 #define STACK_SIZE_MINIMUM 5000
 
@@ -61,6 +63,49 @@ typedef struct
     uint_t refCount; ///<Reference count for the current entry
  } MacFilterEntry;
 
+/**
+ * How a received frame is delivered to the upper layer (result of onPacketHeader).
+ */
+typedef enum
+{
+   RX_DELIVER_COPY,     ///<Read the whole frame into the driver's receive buffer and call onPacketReceived
+   RX_DELIVER_DIRECT,   ///<Read the payload (behind the Ethernet header) directly into the returned buffer
+                        ///<and call onPacketPayloadReceived
+   RX_DELIVER_DISCARD   ///<Nobody wants the frame: release it in the hardware without reading the payload
+} RxDeliveryMode;
+
+/**
+ * Protocols of the checksum offload (see NetInterface.checksumOffload)
+ */
+typedef enum
+{
+   NET_CHECKSUM_IP,     ///<IPv4 header checksum
+   NET_CHECKSUM_TCP,    ///<TCP checksum
+   NET_CHECKSUM_UDP,    ///<UDP checksum
+   NET_CHECKSUM_ICMP,   ///<ICMP checksum
+   NET_CHECKSUM_COUNT
+} NetChecksumProtocol;
+
+/**
+ * A part of a frame to transmit (sendPacketV, sendPackets). The segments of a frame are written back to
+ * back into the TX FIFO, they may have any length (odd bytes are joined with the next segment).
+ */
+typedef struct
+{
+   const uint8_t * data;  ///<Data of the segment (word aligned data is written faster)
+   uint16_t length;       ///<Length of data in bytes
+} NetTxSegment;
+
+/**
+ * One frame of a batched transmit (sendPackets).
+ */
+typedef struct
+{
+   const NetTxSegment * segments;  ///<The frame incl. the Ethernet header (without CRC)
+   uint16_t segmentCount;          ///<Number of segments
+   error_t error;                  ///<Set by sendPackets: NO_ERROR or ERROR_INVALID_LENGTH (frame was skipped)
+} NetTxFrame;
+
 
 /**
  * Common network device interface.
@@ -69,6 +114,8 @@ typedef struct _NetInterface {
 
    //Reference to the "private part" of the driver ("Device Context")
    void * nicContext;
+   //Data of the upper layer for its callbacks (the device driver: its unit), not used by the driver
+   void * userData;
 
    //Probe for available hardware (check if hardware is available)
    error_t (*probe)(struct _NetInterface *);
@@ -88,21 +135,82 @@ typedef struct _NetInterface {
    ULONG (*getUsedSignalNumber)(struct _NetInterface *);
 
    bool (*processEvents)(struct _NetInterface *);
+   //Like processEvents, but called from the software interrupt "bottomHalf". Returns false (and does
+   //nothing) if a task uses the NIC just now: call processEvents from a task then.
+   bool (*processEventsInterrupt)(struct _NetInterface *);
    error_t (*sendPacket)(struct _NetInterface *, uint8_t * buffer, size_t length);
    error_t (*sendPacketCooked)(struct _NetInterface *, MacAddr * dst, MacAddr * src, uint16_t packetType, uint8_t * buffer, size_t length);
+   //Sends a frame that is scattered over several segments (frames shorter than 60 bytes are padded)
+   error_t (*sendPacketV)(struct _NetInterface *, const NetTxSegment * segments, uint16_t count);
+   //Writes as many of the frames as fit into the TX FIFO with one register preamble and queues them for
+   //transmission. Returns the number of processed frames (sent or skipped, see NetTxFrame.error). The frames
+   //behind did not fit into the TX FIFO: txSpaceAvailableFunction is called when there is space for them.
+   uint16_t (*sendPackets)(struct _NetInterface *, NetTxFrame * frames, uint16_t count);
 
    bool (*sendPacketPossible)(struct _NetInterface *, uint16_t size);
    void (*getDefaultNetworkAddress)(struct _NetInterface *, MacAddr *);
    //Set the network mac address that should be used...
    void (*setNetworkAddress)(struct _NetInterface *, MacAddr *);
+   //Set the multicast groups to receive (entries with refCount > 0, at most MAC_MULTICAST_FILTER_SIZE).
+   //NULL receives all multicast frames. Hash filter: frames of other groups can pass too.
+   error_t (*setMulticastFilter)(struct _NetInterface *, const MacFilterEntry filter[], uint8_t entries);
 
 
    const char * (*getConfigFileName)(void);
 
 
    //Accessing the TCP-Stack (from drivers Side): TODO move out...
-   void (*onPacketReceived)(uint8_t * rawPacketEthernet, uint16_t size ); //Function that process received packets (non-isr)
+   //The receive callbacks run with the NIC locked: they may wait for locks of the upper layer, but the upper layer
+   //must not call the functions of this interface while it holds one of these locks (lock order: NIC first).
+   void (*onPacketReceived)(struct _NetInterface * interface, uint8_t * rawPacketEthernet, uint16_t size ); //Function that process received packets (non-isr)
+
+   //Optional: Called with the Ethernet header (14 bytes) of a received frame before the payload is
+   //read from the hardware. Runs while the NIC is locked by the driver, so it must not block.
+   //"size" is the frame size without CRC. Returns RX_DELIVER_DIRECT and the (word aligned) buffer
+   //for the payload in "payloadBuffer" to avoid the copy through the driver's receive buffer,
+   //RX_DELIVER_DISCARD to drop the frame without reading the payload.
+   RxDeliveryMode (*onPacketHeader)(struct _NetInterface * interface, uint8_t * rawPacketHeader, uint16_t size,
+         uint8_t ** payloadBuffer);
+   //Called when the payload of a RX_DELIVER_DIRECT frame was read into the buffer (non-isr)
+   void (*onPacketPayloadReceived)(struct _NetInterface * interface, uint8_t * rawPacketHeader, uint16_t size);
+
    void (*linkChangeFunction)(struct _NetInterface * interface);  //Function that processes links state changes (non-isr)
+   void (*txSpaceAvailableFunction)(struct _NetInterface * interface); //Function that sends the frames that did not fit into the TX FIFO (non-isr)
+
+   //(Re-)Apply the RX interrupt coalescing settings below to the hardware
+   void (*updateRxCoalescing)(struct _NetInterface *);
+   //(Re-)Apply the checksum offload setting below to the hardware
+   void (*updateChecksumOffload)(struct _NetInterface *);
+
+   //RX interrupt coalescing (set before init or call updateRxCoalescing):
+   uint16_t rxCoalesceFrames;             //Max. frames per RX interrupt (0/1: one interrupt per frame)
+   uint16_t rxCoalesceBytes;              //Max. bytes per RX interrupt (0: default)
+   uint16_t rxCoalesceTime;               //Max. delay of a received frame in microseconds (0: default)
+   bool rxCoalesceAdaptive;               //Adapt the frames per interrupt (1..rxCoalesceFrames) to the packet rate
+
+   //RX polling under load: When at least rxPollBudget frames are waiting, the RX interrupt stays disabled
+   //and a timer reads up to rxPollBudget frames every rxPollInterval microseconds. When fewer frames are
+   //waiting, the RX interrupt is enabled again. The timer signals the same signal as the interrupt.
+   uint16_t rxPollBudget;                 //Frames per poll (0: no polling, 1..255). 0 when going online: no timer, no polling
+   uint16_t rxPollInterval;               //Time between two polls in microseconds (0: default)
+   uint32_t rxPolls;                      //Timer polls of the RXQ
+   uint32_t rxPollSwitches;               //Switches from interrupt to polling mode
+
+   bool txAutoEnqueue;                    //Let the NIC queue written TX frames when the FIFO access ends (TXQCR_AETFE)
+
+   //Checksum offload (set before init or call updateChecksumOffload): The hardware fills in the IP, TCP, UDP
+   //and ICMP checksums of all sent IPv4 frames and drops received frames with a wrong checksum.
+   bool checksumOffload;
+   uint32_t rxChecksumErrors[NET_CHECKSUM_COUNT]; //Received frames dropped because of a wrong checksum
+
+   //Receive errors (only the driver changes them, the upper layer reads them)
+   uint32_t rxBadFrames;                  //Invalid frames released by the driver (CRC, length, checksum...)
+   uint32_t rxOverruns;                   //Receiver overruns (frames lost because the RXQ was full)
+
+   //Optional bottom half: The ISR queues this software interrupt with Cause() instead of signaling the
+   //task (see getUsedSignalNumber). It calls processEventsInterrupt, so the callbacks above run in the
+   //software interrupt then and must not wait for locks.
+   struct Interrupt * bottomHalf;
 
    int linkSpeed;                         //Link speed (100 or 10 MBit)
    int duplexMode;
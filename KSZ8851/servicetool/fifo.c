@@ -0,0 +1,278 @@
+/*
+ * KSZ8851 Amiga Network Driver. This file contains the transfer kernels of the QMU FIFOs (the hottest
+ * loops of the driver).
+ *
+ * One kernel family per CPU of the build (ARCH):
+ *  - 68000 and host build: C, Duff's device with blocks of 16 words (no loop counter per word).
+ *  - 68020/68030/68040: inline assembler, blocks of 16 "move.w" between port and memory plus a dbra loop
+ *    for the rest. Little endian mode swaps with "ror.w #8" in a register.
+ *  - 68060: like 68020, but the little endian kernels handle two words interleaved, so both pipes of the
+ *    superscalar 68060 are busy.
+ *
+ * The assembler kernels count their port accesses for the profiler (see profile.h) per call.
+ *
+ * "movem" bursts (and long word moves) are not possible with this chip: The data port is a single word
+ * address and the command register follows at +2.
+ */
+
+#include "fifo.h"
+
+#if !defined(KSZ8851_SIMULATOR) && (defined(__mc68020__) || defined(__mc68030__) || defined(__mc68040__) || defined(__mc68060__))
+   #define FIFO_ASM_KERNELS
+#endif
+
+#ifdef FIFO_ASM_KERNELS
+
+//The data port (see KSZ8851_DATA_REG)
+#define FIFO_PORT ((volatile uint16_t *) ETHERNET_BASE_ADDRESS)
+
+#define REPEAT8(s)  s s s s s s s s
+#define REPEAT16(s) REPEAT8(s) REPEAT8(s)
+
+#if defined(__mc68060__)
+const char * const ksz8851FifoKernelName = "68060 (asm, unrolled x16, paired swaps)";
+#elif defined(__mc68040__)
+const char * const ksz8851FifoKernelName = "68040 (asm, unrolled x16)";
+#else
+const char * const ksz8851FifoKernelName = "68020/68030 (asm, unrolled x16)";
+#endif
+
+void ksz8851FifoReadWords(uint16_t * data, uint16_t count)
+{
+   uint16_t blocks = count >> 4;
+   uint16_t rest   = count & (FIFO_BLOCK_WORDS - 1);
+
+   KSZ8851_PROFILE_COUNT(dataReads, count);
+   __asm volatile (
+         "   bra.s    2f\n"
+         "1:\n"
+         REPEAT16("   move.w   (%3),(%0)+\n")
+         "2: dbra     %1,1b\n"
+         "   bra.s    4f\n"
+         "3: move.w   (%3),(%0)+\n"
+         "4: dbra     %2,3b\n"
+         : "+a" (data), "+d" (blocks), "+d" (rest)
+         : "a" (FIFO_PORT)
+         : "memory");
+}
+
+void ksz8851FifoWriteWords(const uint16_t * data, uint16_t count)
+{
+   uint16_t blocks = count >> 4;
+   uint16_t rest   = count & (FIFO_BLOCK_WORDS - 1);
+
+   KSZ8851_PROFILE_COUNT(dataWrites, count);
+   __asm volatile (
+         "   bra.s    2f\n"
+         "1:\n"
+         REPEAT16("   move.w   (%0)+,(%3)\n")
+         "2: dbra     %1,1b\n"
+         "   bra.s    4f\n"
+         "3: move.w   (%0)+,(%3)\n"
+         "4: dbra     %2,3b\n"
+         : "+a" (data), "+d" (blocks), "+d" (rest)
+         : "a" (FIFO_PORT)
+         : "memory");
+}
+
+#if defined(__mc68060__)
+
+void ksz8851FifoReadWordsSwapped(uint16_t * data, uint16_t count)
+{
+   uint16_t blocks = count >> 4;
+   uint16_t rest   = count & (FIFO_BLOCK_WORDS - 1);
+   uint16_t value0, value1;
+
+   KSZ8851_PROFILE_COUNT(dataReads, count);
+   __asm volatile (
+         "   bra.s    2f\n"
+         "1:\n"
+         REPEAT8("   move.w   (%5),%3\n"
+                 "   move.w   (%5),%4\n"
+                 "   ror.w    #8,%3\n"
+                 "   ror.w    #8,%4\n"
+                 "   move.w   %3,(%0)+\n"
+                 "   move.w   %4,(%0)+\n")
+         "2: dbra     %1,1b\n"
+         "   bra.s    4f\n"
+         "3: move.w   (%5),%3\n"
+         "   ror.w    #8,%3\n"
+         "   move.w   %3,(%0)+\n"
+         "4: dbra     %2,3b\n"
+         : "+a" (data), "+d" (blocks), "+d" (rest), "=&d" (value0), "=&d" (value1)
+         : "a" (FIFO_PORT)
+         : "memory");
+}
+
+void ksz8851FifoWriteWordsSwapped(const uint16_t * data, uint16_t count)
+{
+   uint16_t blocks = count >> 4;
+   uint16_t rest   = count & (FIFO_BLOCK_WORDS - 1);
+   uint16_t value0, value1;
+
+   KSZ8851_PROFILE_COUNT(dataWrites, count);
+   __asm volatile (
+         "   bra.s    2f\n"
+         "1:\n"
+         REPEAT8("   move.w   (%0)+,%3\n"
+                 "   move.w   (%0)+,%4\n"
+                 "   ror.w    #8,%3\n"
+                 "   ror.w    #8,%4\n"
+                 "   move.w   %3,(%5)\n"
+                 "   move.w   %4,(%5)\n")
+         "2: dbra     %1,1b\n"
+         "   bra.s    4f\n"
+         "3: move.w   (%0)+,%3\n"
+         "   ror.w    #8,%3\n"
+         "   move.w   %3,(%5)\n"
+         "4: dbra     %2,3b\n"
+         : "+a" (data), "+d" (blocks), "+d" (rest), "=&d" (value0), "=&d" (value1)
+         : "a" (FIFO_PORT)
+         : "memory");
+}
+
+#else
+
+void ksz8851FifoReadWordsSwapped(uint16_t * data, uint16_t count)
+{
+   uint16_t blocks = count >> 4;
+   uint16_t rest   = count & (FIFO_BLOCK_WORDS - 1);
+   uint16_t value;
+
+   KSZ8851_PROFILE_COUNT(dataReads, count);
+   __asm volatile (
+         "   bra.s    2f\n"
+         "1:\n"
+         REPEAT16("   move.w   (%4),%3\n"
+                  "   ror.w    #8,%3\n"
+                  "   move.w   %3,(%0)+\n")
+         "2: dbra     %1,1b\n"
+         "   bra.s    4f\n"
+         "3: move.w   (%4),%3\n"
+         "   ror.w    #8,%3\n"
+         "   move.w   %3,(%0)+\n"
+         "4: dbra     %2,3b\n"
+         : "+a" (data), "+d" (blocks), "+d" (rest), "=&d" (value)
+         : "a" (FIFO_PORT)
+         : "memory");
+}
+
+void ksz8851FifoWriteWordsSwapped(const uint16_t * data, uint16_t count)
+{
+   uint16_t blocks = count >> 4;
+   uint16_t rest   = count & (FIFO_BLOCK_WORDS - 1);
+   uint16_t value;
+
+   KSZ8851_PROFILE_COUNT(dataWrites, count);
+   __asm volatile (
+         "   bra.s    2f\n"
+         "1:\n"
+         REPEAT16("   move.w   (%0)+,%3\n"
+                  "   ror.w    #8,%3\n"
+                  "   move.w   %3,(%4)\n")
+         "2: dbra     %1,1b\n"
+         "   bra.s    4f\n"
+         "3: move.w   (%0)+,%3\n"
+         "   ror.w    #8,%3\n"
+         "   move.w   %3,(%4)\n"
+         "4: dbra     %2,3b\n"
+         : "+a" (data), "+d" (blocks), "+d" (rest), "=&d" (value)
+         : "a" (FIFO_PORT)
+         : "memory");
+}
+
+#endif
+
+void ksz8851FifoSkipWords(uint16_t count)
+{
+   uint16_t blocks = count >> 4;
+   uint16_t rest   = count & (FIFO_BLOCK_WORDS - 1);
+
+   KSZ8851_PROFILE_COUNT(dataReads, count);
+   __asm volatile (
+         "   bra.s    2f\n"
+         "1:\n"
+         REPEAT16("   tst.w    (%2)\n")
+         "2: dbra     %0,1b\n"
+         "   bra.s    4f\n"
+         "3: tst.w    (%2)\n"
+         "4: dbra     %1,3b\n"
+         : "+d" (blocks), "+d" (rest)
+         : "a" (FIFO_PORT)
+         : "memory");
+}
+
+#else
+
+#ifdef KSZ8851_SIMULATOR
+const char * const ksz8851FifoKernelName = "host (C, unrolled x16)";
+#else
+const char * const ksz8851FifoKernelName = "68000 (C, unrolled x16)";
+#endif
+
+/*
+ * Duff's device: Jumps into a block of 16 operations for the rest, then loops over whole blocks.
+ */
+#define DUFF_DEVICE(count, operation) \
+   if (count) { \
+      uint16_t blocks = ((uint32_t)(count) + FIFO_BLOCK_WORDS - 1) >> 4; \
+      switch ((count) & (FIFO_BLOCK_WORDS - 1)) { \
+         case 0:  do { operation; \
+         case 15:      operation; \
+         case 14:      operation; \
+         case 13:      operation; \
+         case 12:      operation; \
+         case 11:      operation; \
+         case 10:      operation; \
+         case 9:       operation; \
+         case 8:       operation; \
+         case 7:       operation; \
+         case 6:       operation; \
+         case 5:       operation; \
+         case 4:       operation; \
+         case 3:       operation; \
+         case 2:       operation; \
+         case 1:       operation; \
+                  } while (--blocks); \
+      } \
+   }
+
+/**
+ * Word of the data port in little endian mode as it is stored in memory: The bytes are swapped on the
+ * 68k ("ror.w #8"), but not on a little endian host.
+ */
+static inline uint16_t lePortWord(uint16_t value)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   return value;
+#else
+   return (uint16_t)((value << 8) | (value >> 8));
+#endif
+}
+
+void ksz8851FifoReadWords(uint16_t * data, uint16_t count)
+{
+   DUFF_DEVICE(count, *(data++) = KSZ8851_DATA_READ())
+}
+
+void ksz8851FifoReadWordsSwapped(uint16_t * data, uint16_t count)
+{
+   DUFF_DEVICE(count, *(data++) = lePortWord(KSZ8851_DATA_READ()))
+}
+
+void ksz8851FifoWriteWords(const uint16_t * data, uint16_t count)
+{
+   DUFF_DEVICE(count, KSZ8851_DATA_WRITE(*(data++)))
+}
+
+void ksz8851FifoWriteWordsSwapped(const uint16_t * data, uint16_t count)
+{
+   DUFF_DEVICE(count, KSZ8851_DATA_WRITE(lePortWord(*(data++))))
+}
+
+void ksz8851FifoSkipWords(uint16_t count)
+{
+   DUFF_DEVICE(count, (void)KSZ8851_DATA_READ())
+}
+
+#endif
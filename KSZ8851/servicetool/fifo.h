@@ -0,0 +1,56 @@
+#ifndef _KSZ8851_FIFO_H
+#define _KSZ8851_FIFO_H
+
+#include "ksz8851.h"
+
+/*
+ * Transfer kernels for the data port of the QMU FIFOs. The kernel family is selected by the CPU of the
+ * build (ARCH, see fifo.c). All buffers must be word aligned.
+ *
+ * The "Swapped" kernels are for the chip in little endian mode: The first byte in memory is the low
+ * byte of the port word.
+ */
+
+//Number of words that are transferred per block of the unrolled kernels
+#define FIFO_BLOCK_WORDS 16
+
+/**
+ * Name of the kernel family of this build (service tool output)
+ */
+extern const char * const ksz8851FifoKernelName;
+
+/**
+ * Reads "count" words from the data port (big endian mode)
+ * @param data word aligned buffer
+ * @param count number of words
+ */
+void ksz8851FifoReadWords(uint16_t * data, uint16_t count);
+
+/**
+ * Reads "count" words from the data port, swapping the bytes (little endian mode)
+ * @param data word aligned buffer
+ * @param count number of words
+ */
+void ksz8851FifoReadWordsSwapped(uint16_t * data, uint16_t count);
+
+/**
+ * Writes "count" words to the data port (big endian mode)
+ * @param data word aligned buffer
+ * @param count number of words
+ */
+void ksz8851FifoWriteWords(const uint16_t * data, uint16_t count);
+
+/**
+ * Writes "count" words to the data port, swapping the bytes (little endian mode)
+ * @param data word aligned buffer
+ * @param count number of words
+ */
+void ksz8851FifoWriteWordsSwapped(const uint16_t * data, uint16_t count);
+
+/**
+ * Reads and throws away "count" words from the data port
+ * @param count number of words
+ */
+void ksz8851FifoSkipWords(uint16_t count);
+
+#endif
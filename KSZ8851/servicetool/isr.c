@@ -41,8 +41,12 @@
     //Call the handler. Check if the interrupt was from our hardware...
     if (ksz8851IrqHandler(interface)) {
        SetBackgroundColor(0xa);
-       //Signal the service task
-       Signal(context->signalTask, (1 << context->sigNumber));
+       //Run the bottom half right after the interrupt or signal the service task
+       if (interface->bottomHalf) {
+          Cause(interface->bottomHalf);
+       } else {
+          Signal(context->signalTask, (1 << context->sigNumber));
+       }
        context->signalCounter++;
 
        //Stop the interrupt chain. Signal that we processed this interrupt.
@@ -53,6 +57,80 @@
     return (uint8_t)0;
  }
 
+ /*
+  * Opens timer.device for the RX polling (only with a poll budget). The reply port signals the task and signal
+  * of the ISR: an expired poll timer calls the event handler like an interrupt. Without the timer the RX
+  * interrupt is always used.
+  */
+ static void installPollTimer(NetInterface * interface)
+ {
+    Ksz8851Context * context = (Ksz8851Context*)interface->nicContext;
+
+    context->pollTimerRunning = false;
+    context->rxPolling        = false;
+    if (!interface->rxPollBudget) {
+       return;
+    }
+
+    context->pollPort.mp_Node.ln_Type = NT_MSGPORT;
+    context->pollPort.mp_Node.ln_Name = "KSZ8851 RX poll timer";
+    context->pollPort.mp_Flags        = PA_SIGNAL;
+    context->pollPort.mp_SigBit       = context->sigNumber;
+    context->pollPort.mp_SigTask      = context->signalTask;
+    NewList(&context->pollPort.mp_MsgList);
+
+    context->pollTimer.tr_node.io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+    context->pollTimer.tr_node.io_Message.mn_ReplyPort    = &context->pollPort;
+    context->pollTimer.tr_node.io_Message.mn_Length       = sizeof(context->pollTimer);
+
+    context->pollTimerOpen = OpenDevice(TIMERNAME, UNIT_MICROHZ, &context->pollTimer.tr_node, 0) == 0;
+    if (!context->pollTimerOpen) {
+       TRACE_DEBUG("No timer.device: RX polling disabled\n");
+    }
+ }
+
+ static void uninstallPollTimer(NetInterface * interface)
+ {
+    Ksz8851Context * context = (Ksz8851Context*)interface->nicContext;
+
+    if (context->pollTimerOpen) {
+       if (context->pollTimerRunning) {
+          AbortIO(&context->pollTimer.tr_node);
+          WaitIO(&context->pollTimer.tr_node);
+          context->pollTimerRunning = false;
+       }
+       CloseDevice(&context->pollTimer.tr_node);
+       context->pollTimerOpen = false;
+    }
+    context->rxPolling = false;
+ }
+
+ void startPollTimer(NetInterface * interface)
+ {
+    Ksz8851Context * context = (Ksz8851Context*)interface->nicContext;
+
+    if (context->pollTimerOpen && !context->pollTimerRunning) {
+       context->pollTimer.tr_node.io_Command = TR_ADDREQUEST;
+       context->pollTimer.tr_time.tv_secs    = 0;
+       context->pollTimer.tr_time.tv_micro   = interface->rxPollInterval ? interface->rxPollInterval :
+                                               KSZ8851_RX_POLL_DEFAULT_INTERVAL;
+       context->pollTimerRunning = true;
+       SendIO(&context->pollTimer.tr_node);
+    }
+ }
+
+ bool pollTimerExpired(NetInterface * interface)
+ {
+    Ksz8851Context * context = (Ksz8851Context*)interface->nicContext;
+
+    //The timer is the only message of the port
+    if (context->pollTimerRunning && GetMsg(&context->pollPort)) {
+       context->pollTimerRunning = false;
+       return true;
+    }
+    return false;
+ }
+
  BOOL installInterruptHandler(NetInterface * interface)
  {
     Ksz8851Context * context = (Ksz8851Context*)interface->nicContext;
@@ -83,6 +161,8 @@
     //Network chip uses (INT6) which is "external interrupt" on AmigaOS.
     AddIntServer(INTB_EXTER, &context->AmigaInterrupt);
 
+    installPollTimer(interface);
+
     return TRUE;
  }
 
@@ -91,8 +171,9 @@
     Ksz8851Context * context = (Ksz8851Context*)interface->nicContext;
     if(context->signalTask)
     {
-       //Free interrupt and signal number...
+       //Free interrupt, poll timer and signal number...
        RemIntServer(INTB_EXTER, &context->AmigaInterrupt);
+       uninstallPollTimer(interface);
        context->signalTask = NULL;
        FreeSignal(context->sigNumber);
        context->sigNumber= -1;
@@ -17,4 +17,18 @@ BOOL installInterruptHandler(NetInterface * interface);
  */
 void uninstallInterruptHandler(NetInterface * interface);
 
+/**
+ * Starts the RX poll timer (NetInterface.rxPollInterval) unless it is already running. The expired timer
+ * signals the task of the ISR. Callable from the task and from the bottom half.
+ * @param interface
+ */
+void startPollTimer(NetInterface * interface);
+
+/**
+ * Takes the expired RX poll timer from its reply port.
+ * @param interface
+ * @return true if the timer has expired since it was started
+ */
+bool pollTimerExpired(NetInterface * interface);
+
 #endif
@@ -4,6 +4,7 @@
 
 #include "ksz8851.h"
 #include "isr.h"
+#include "fifo.h"
 
 //Do not use these functions. They cause linker errors on the device...
 #define printf(...) DoNotusePrintf
@@ -12,35 +13,58 @@
 //Values of the GRR Register:
 #define GRR_NO_RESET          0
 
-#if 0
 /**
-  * Temporary disable all ints from NIC. Return old IER mask...
+  * Gets exclusive access to the NIC for the current task: Other tasks wait (semaphore) and all NIC
+  * interrupts are masked in IER, so the ISR doesn't touch the NIC registers (see isr()). Unlike
+  * Disable() the other interrupts of the system are not blocked during long FIFO transfers.
+  * Calls can be nested.
+  *
+  * Lock order: The NIC lock comes before the locks of the upper layer. The receive callbacks
+  * (onPacketReceived, onPacketPayloadReceived) run with the NIC locked and may wait for the locks of their
+  * lists. So the upper layer must never call a function of the NIC interface while it holds such a lock.
+  * onPacketHeader doesn't wait at all. The NIC is unlocked again before txSpaceAvailableFunction is called.
   * @param interface
-  * @return
+  * @return the saved IER mask
   */
- static uint16_t ksz8851DisableInterrupts(NetInterface * interface) {
+ uint16_t ksz8851DisableInterrupts(NetInterface * interface) {
     Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    //The software interrupt can't wait for the lock (see ksz8851EventHandlerInterrupt)
+    if (!context->inSoftInt) {
+       ObtainSemaphore(&context->nicLock);
+    }
+    //Disable() only for the few accesses the ISR could interrupt
     Disable();
-    context->intDisabledCounter++;
-    uint16_t oldMask = ksz8851ReadReg(interface, KSZ8851_REG_IER);
-    ksz8851WriteReg(interface, KSZ8851_REG_IER, 0); //disable all ints...
+    if (context->intDisabledCounter++ == 0) {
+       context->ierMask = context->ier;
+       ksz8851WriteShadowReg(interface, KSZ8851_REG_IER, 0); //disable all ints...
+    }
     Enable();
-    return oldMask;
+    return context->ierMask;
  }
 
  /**
-  * Enable all NIC its again (after disable)
+  * Releases the NIC again (after ksz8851DisableInterrupts). When the outermost lock is released, the
+  * saved IER mask plus "enableMask" is written back.
   * @param interface
-  * @param ierMask
+  * @param enableMask additional interrupts to enable
   */
- static void ksz8851EnableInterrupts(NetInterface * interface, uint16_t ierMask) {
+ void ksz8851EnableInterrupts(NetInterface * interface, uint16_t enableMask) {
     Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+#if DEBUG > 0
+    if (context->intDisabledCounter == 1) {
+       ksz8851CheckShadowRegs(interface);
+    }
+#endif
     Disable();
-    context->intDisabledCounter--;
-    ksz8851SetBit(interface, KSZ8851_REG_IER, ierMask);
+    context->ierMask |= enableMask;
+    if (--context->intDisabledCounter == 0) {
+       ksz8851WriteShadowReg(interface, KSZ8851_REG_IER, context->ierMask);
+    }
     Enable();
+    if (!context->inSoftInt) {
+       ReleaseSemaphore(&context->nicLock);
+    }
  }
-#endif
 
 /**
  * @brief Enable interrupts (must be called from right Amiga Task!)
@@ -50,21 +74,20 @@ void ksz8851Online(NetInterface *interface)
 {
    installInterruptHandler(interface);
 
-   Disable();
+   ksz8851DisableInterrupts(interface);
    //Clear interrupt flags
    ksz8851SetBit(interface, KSZ8851_REG_ISR, ISR_LCIS | ISR_TXIS |
          ISR_RXIS | ISR_RXOIS | ISR_TXPSIS | ISR_RXPSIS | ISR_TXSAIS |
          ISR_RXWFDIS | ISR_RXMPDIS | ISR_LDIS | ISR_EDIS | ISR_SPIBEIS);
 
-   //Configure interrupts as desired (this enables interrupts. Be sure that the ISR is installed!)
-   ksz8851SetBit(interface, KSZ8851_REG_IER, IER_LCIE | /*IER_TXIE |*/ IER_RXIE | IER_RXOIE);
-
    //Enable TX operation
    ksz8851SetBit(interface, KSZ8851_REG_TXCR, TXCR_TXE);
 
    //Enable RX operation
    ksz8851SetBit(interface, KSZ8851_REG_RXCR1, RXCR1_RXE);
-   Enable();
+
+   //Configure interrupts as desired (this enables interrupts. Be sure that the ISR is installed!)
+   ksz8851EnableInterrupts(interface, IER_LCIE | /*IER_TXIE |*/ IER_RXIE | IER_RXOIE);
 }
 
 
@@ -74,33 +97,53 @@ void ksz8851Online(NetInterface *interface)
  **/
 void ksz8851Offline(NetInterface *interface)
 {
-   //Disable all NIC interrupts to release the interrupt line
-   Disable();
-   ksz8851WriteReg(interface, KSZ8851_REG_IER, 0);
+   Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+
+   //Disable all NIC interrupts to release the interrupt line (they stay disabled when unlocked)
+   ksz8851DisableInterrupts(interface);
+   context->ierMask = 0;
    //Disable TX operation
    ksz8851ClearBit(interface, KSZ8851_REG_TXCR, TXCR_TXE);
    //Enable RX operation
    ksz8851ClearBit(interface, KSZ8851_REG_RXCR1, RXCR1_RXE);
-   Enable();
+   ksz8851EnableInterrupts(interface, 0);
 
    uninstallInterruptHandler(interface);
+
+#if defined(KSZ8851_PROFILE) && DEBUG > 0
+   //Export the register accesses of the session (make debug PROFILE=1)
+   ksz8851ProfileDump(traceout);
+#endif
 }
 
 static void ksz8851PrintNICEndiness(Ksz8851Context * context) {
     TRACE_INFO("Current Endian Mode: %s\n", context->isInBigEndianMode ? "BE" : "LE");
 }
 
+/*
+ * Register accesses of the probe and reset path: The bus mode of the chip is not known yet, even if it is fixed
+ * at compile time for all other accesses (KSZ8851_FIXED_BIG_ENDIAN).
+ */
+static uint16_t ksz8851ProbeReadReg(NetInterface *interface, uint8_t offset) {
+   return ksz8851ReadRegMode(offset, ((Ksz8851Context *)interface->nicContext)->isInBigEndianMode);
+}
+
+static void ksz8851ProbeWriteReg(NetInterface *interface, uint8_t offset, uint16_t value) {
+   ksz8851WriteRegMode(offset, value, ((Ksz8851Context *)interface->nicContext)->isInBigEndianMode);
+}
+
 /**
  * Change endianness mode of the NIC
  * @param bigEndian
  */
 static void ksz8851SwitchEndianessMode(NetInterface *interface, bool bigEndian) {
    Ksz8851Context * context = (Ksz8851Context *)interface->nicContext;
-   uint16_t value = ksz8851ReadReg(interface, KSZ8851_REG_RXFDPR);
+   uint16_t value = ksz8851ProbeReadReg(interface, KSZ8851_REG_RXFDPR);
    if (bigEndian) {
       value |= RXFDPR_EMS; //Bit 11 = 1   => BigEndian, Bit can't read back!
    }
-   ksz8851WriteReg(interface, KSZ8851_REG_RXFDPR, value);
+   ksz8851ProbeWriteReg(interface, KSZ8851_REG_RXFDPR, value);
+   context->rxfdpr = value;
    //Change mode so that all functions still can talk to the chip!
    context->isInBigEndianMode = bigEndian;
 }
@@ -115,9 +158,9 @@ static error_t ksz8851DetectNICEndiness(NetInterface *interface) {
    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
 
    //Check in which mode the NIC is now
-   if (ksz8851ReadReg(interface, KSZ8851_REG_CIDER) != KSZ8851_REV_A3_ID) {
+   if (ksz8851ProbeReadReg(interface, KSZ8851_REG_CIDER) != KSZ8851_REV_A3_ID) {
       context->isInBigEndianMode = !context->isInBigEndianMode; //toggle endian mode and try again...
-      if (ksz8851ReadReg(interface, KSZ8851_REG_CIDER) != KSZ8851_REV_A3_ID) {
+      if (ksz8851ProbeReadReg(interface, KSZ8851_REG_CIDER) != KSZ8851_REV_A3_ID) {
          return NO_CHIP_FOUND;
       }
    }
@@ -143,6 +186,23 @@ static void dumpMem(uint8_t * mem, int16_t len) {
 
 
  /**
+ * Writes the multicast filter of the context (see ksz8851SetMulticastFilter) to the hash table and RXCR1.
+ * NIC must be locked.
+ */
+static void ksz8851WriteMulticastFilter(NetInterface *interface) {
+   Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+   ksz8851WriteReg(interface, KSZ8851_REG_MAHTR0, context->multicastHash[0]);
+   ksz8851WriteReg(interface, KSZ8851_REG_MAHTR1, context->multicastHash[1]);
+   ksz8851WriteReg(interface, KSZ8851_REG_MAHTR2, context->multicastHash[2]);
+   ksz8851WriteReg(interface, KSZ8851_REG_MAHTR3, context->multicastHash[3]);
+   if (context->allMulticast) {
+      ksz8851SetBit(interface, KSZ8851_REG_RXCR1, RXCR1_RXMAFMA);
+   } else {
+      ksz8851ClearBit(interface, KSZ8851_REG_RXCR1, RXCR1_RXMAFMA);
+   }
+}
+
+/**
   * @brief KSZ8851 controller initialization
   * @param[in] interface Underlying network interface
   * @return Error code
@@ -153,8 +213,10 @@ error_t ksz8851Init(NetInterface *interface)
 
     //Point to the driver context
     Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    KSZ8851_PROFILE_ENTER(KSZ8851_OP_RESET);
 
-    Disable();
+    //The ISR is not installed yet (offline): Only other tasks must be kept away
+    ObtainSemaphore(&context->nicLock);
 
     //Debug message
     TRACE_INFO("Initializing KSZ8851 Ethernet controller...\r\n");
@@ -169,11 +231,11 @@ error_t ksz8851Init(NetInterface *interface)
        TRACE_INFO("Unable to detect NIC in endian mode '%s'). Now hard resetting NIC in both modes...\n",
              context->isInBigEndianMode ? "big" : "little");
        context->isInBigEndianMode = false;
-       ksz8851WriteReg(interface, KSZ8851_REG_GRR, GRR_GLOBAL_SOFT_RST);
-       ksz8851WriteReg(interface, KSZ8851_REG_GRR, GRR_NO_RESET);
+       ksz8851ProbeWriteReg(interface, KSZ8851_REG_GRR, GRR_GLOBAL_SOFT_RST);
+       ksz8851ProbeWriteReg(interface, KSZ8851_REG_GRR, GRR_NO_RESET);
        context->isInBigEndianMode = true;
-       ksz8851WriteReg(interface, KSZ8851_REG_GRR, GRR_GLOBAL_SOFT_RST);
-       ksz8851WriteReg(interface, KSZ8851_REG_GRR, GRR_NO_RESET);
+       ksz8851ProbeWriteReg(interface, KSZ8851_REG_GRR, GRR_GLOBAL_SOFT_RST);
+       ksz8851ProbeWriteReg(interface, KSZ8851_REG_GRR, GRR_NO_RESET);
        //Let it in BE mode which is preferred mode for 68k processors
 
        //Wait a little bit...
@@ -185,7 +247,7 @@ error_t ksz8851Init(NetInterface *interface)
     ksz8851SoftReset(interface,GRR_QMU_MODULE_SOFT_RST);
 
     //Re-detect NIC after reset...
-    if (ksz8851ReadReg(interface, KSZ8851_REG_CIDER) != KSZ8851_REV_A3_ID) {
+    if (ksz8851ProbeReadReg(interface, KSZ8851_REG_CIDER) != KSZ8851_REV_A3_ID) {
        TRACE_INFO("Finally unable to detect NIC!\n");
        ksz8851DumpReg(interface);
        result = ERROR_WRONG_IDENTIFIER;
@@ -226,23 +288,30 @@ error_t ksz8851Init(NetInterface *interface)
     ksz8851WriteReg(interface, KSZ8851_REG_TXCR, TXCR_TXFCE | TXCR_TXPE | TXCR_TXCE);
     //Automatically increment TX data pointer
     ksz8851WriteReg(interface, KSZ8851_REG_TXFDPR, TXFDPR_TXFPAI);
+    //Queue written TX frames automatically when the TXQ access ends (or manually by TXQCR_METFE)
+    context->txAutoEnqueue = interface->txAutoEnqueue;
+    ksz8851WriteShadowReg(interface, KSZ8851_REG_TXQCR, context->txAutoEnqueue ? TXQCR_AETFE : 0);
 
     //Configure address filtering
     ksz8851WriteReg(interface, KSZ8851_REG_RXCR1,
        RXCR1_RXPAFMA | RXCR1_RXFCE | RXCR1_RXBE | RXCR1_RXME | RXCR1_RXUE);
+    //Multicast groups (kept over a reset)
+    ksz8851WriteMulticastFilter(interface);
 
-    //No checksum verification
+    //Single frame data burst, pass UDP fragments and UDP frames without checksum
     ksz8851WriteReg(interface, KSZ8851_REG_RXCR2,
        RXCR2_SRDBL2 | RXCR2_IUFFP | RXCR2_RXIUFCEZ);
+    //Checksum generation and verification (RXCR1, RXCR2, TXCR)
+    ksz8851SetChecksumOffload(interface);
 
     //Enable automatic RXQ frame buffer dequeue
     //+ add 2 extra dummy byte (before dest address) for 4-byte alignment of packet data (RXQCR_RXIPHTOE):
-    ksz8851WriteReg(interface, KSZ8851_REG_RXQCR, RXQCR_RXFCTE | RXQCR_ADRFE | RXQCR_RXIPHTOE);
-    //Automatically increment RX data pointer
-    uint16_t val = context->isInBigEndianMode ? (RXFDPR_RXFPAI | RXFDPR_EMS) : (RXFDPR_RXFPAI);
-    ksz8851WriteReg(interface, KSZ8851_REG_RXFDPR, val);
-    //Configure receive frame count threshold
-    ksz8851WriteReg(interface, KSZ8851_REG_RXFCTR, 1);
+    ksz8851WriteShadowReg(interface, KSZ8851_REG_RXQCR, RXQCR_ADRFE | RXQCR_RXIPHTOE);
+    //Automatically increment RX data pointer (the shadow keeps the endian mode, see ksz8851ReceivePacket)
+    uint16_t val = KSZ8851_IS_BIG_ENDIAN(context) ? (RXFDPR_RXFPAI | RXFDPR_EMS) : (RXFDPR_RXFPAI);
+    ksz8851WriteShadowReg(interface, KSZ8851_REG_RXFDPR, val);
+    //Configure receive thresholds (frame count, byte count, duration timer)
+    ksz8851SetRxCoalescing(interface);
 
     //Force link in half-duplex if auto-negotiation failed
     ksz8851ClearBit(interface, KSZ8851_REG_P1CR, P1CR_FORCE_DUPLEX);
@@ -253,8 +322,9 @@ error_t ksz8851Init(NetInterface *interface)
 
     end:
 
-    Enable();
+    ReleaseSemaphore(&context->nicLock);
 
+    KSZ8851_PROFILE_LEAVE();
     //Successful initialization
     return result;
  }
@@ -266,30 +336,35 @@ error_t ksz8851Init(NetInterface *interface)
   */
  void ksz8851SoftReset(NetInterface *interface, uint8_t resetOperation)
  {
+    KSZ8851_PROFILE_ENTER(KSZ8851_OP_RESET);
+
     if (!ksz8851DetectNICEndiness(interface)) {
+       KSZ8851_PROFILE_LEAVE();
        return;
     }
 
     /* Disable interrupt first */
-    uint16_t oldisr = ksz8851ReadReg(interface, KSZ8851_REG_ISR);
-    ksz8851WriteReg(interface, KSZ8851_REG_ISR, 0x0000);
+    uint16_t oldisr = ksz8851ProbeReadReg(interface, KSZ8851_REG_ISR);
+    ksz8851ProbeWriteReg(interface, KSZ8851_REG_ISR, 0x0000);
 
     //Perform reset command
-    ksz8851WriteReg(interface, KSZ8851_REG_GRR, resetOperation);
+    ksz8851ProbeWriteReg(interface, KSZ8851_REG_GRR, resetOperation);
     /* wait a short time to effect reset */
     Delay(25);
     //release soft reset again
-    ksz8851WriteReg(interface, KSZ8851_REG_GRR, 0);
+    ksz8851ProbeWriteReg(interface, KSZ8851_REG_GRR, 0);
     /* wait for condition to clear */
     Delay(10);
 
     //Detect endiness after reset again...
     if (!ksz8851DetectNICEndiness(interface)) {
+       KSZ8851_PROFILE_LEAVE();
        return;
     }
 
     //Re-enable all interrupt flags again...
-    ksz8851WriteReg(interface, KSZ8851_REG_ISR, oldisr);
+    ksz8851ProbeWriteReg(interface, KSZ8851_REG_ISR, oldisr);
+    KSZ8851_PROFILE_LEAVE();
  }
 
  /**
@@ -299,9 +374,11 @@ error_t ksz8851Init(NetInterface *interface)
   **/
  bool_t ksz8851IrqHandler(register NetInterface *interface)
  {
+    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
     bool_t signaled;
     uint16_t ier;
     uint16_t isr;
+    KSZ8851_PROFILE_ENTER(KSZ8851_OP_ISR);
     signaled = FALSE;
 
     //
@@ -311,13 +388,14 @@ error_t ksz8851Init(NetInterface *interface)
 
     //Read interrupt status register
     isr = ksz8851ReadReg(interface, KSZ8851_REG_ISR);
-    //Save IER register value
-    ier = ksz8851ReadReg(interface, KSZ8851_REG_IER);
+    //Current IER register value (shadow: the NIC is not locked, otherwise the ISR would not call us)
+    ier = context->ier;
 
     //Because we here can be called from not only our own interrupts, we have to check if the signaled
     //hardware interrupt of the NIC is enabled by the NIC. If not, it's not our interrupt...
     if (0 == (isr & ier)) {
        //Interrupt is not from our hardware
+       KSZ8851_PROFILE_LEAVE();
        return false;
     }
 
@@ -326,7 +404,7 @@ error_t ksz8851Init(NetInterface *interface)
     //
 
     //Disable all interrupts to release the Amiga interrupt line
-    ksz8851WriteReg(interface, KSZ8851_REG_IER, 0);
+    ksz8851WriteShadowReg(interface, KSZ8851_REG_IER, 0);
 
     //Link status change?
     if(isr & ISR_LCIS)
@@ -354,6 +432,15 @@ error_t ksz8851Init(NetInterface *interface)
        signaled = TRUE;
     }
 
+    //Enough TXQ memory for the next frame available?
+    if(isr & ISR_TXSAIS)
+    {
+       //One shot: armed again by ksz8851SendPackets when a frame does not fit. The NIC has cleared TXQMAM.
+       ier &= ~IER_TXSAIE;
+       context->txqcr &= ~TXQCR_TXQMAM;
+       signaled = TRUE;
+    }
+
     //Packet received?
     if(isr & ISR_RXIS)
     {
@@ -387,8 +474,9 @@ error_t ksz8851Init(NetInterface *interface)
     }
 
     //Re-enable all not handles ints again. All detected ints are still disabled and must be re-enabled later!
-    ksz8851WriteReg(interface, KSZ8851_REG_IER, ier);
+    ksz8851WriteShadowReg(interface, KSZ8851_REG_IER, ier);
 
+    KSZ8851_PROFILE_LEAVE();
     //true: It's our interrupt event, false: not our interrupt
     return signaled;
  }
@@ -403,6 +491,10 @@ error_t ksz8851Init(NetInterface *interface)
     uint16_t status;
     uint8_t  frameCount;
     uint16_t enableMask = 0;
+    bool txSpaceAvailable = false;
+    bool pollNow;
+    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    KSZ8851_PROFILE_ENTER(KSZ8851_OP_EVENT);
 
     //
     // All occurred NIC ints are still disabled when the method is called. but other ints can be still
@@ -411,8 +503,7 @@ error_t ksz8851Init(NetInterface *interface)
 
     //Because the function can be called at any time and an interrupt call can change registers contents
     //we must ensure, that we have exclusive access to the NIC registers by disabling all NIC ints...
-    //uint16_t oldIER = ksz8851DisableInterrupts(interface);
-    Disable();
+    ksz8851DisableInterrupts(interface);
 
     //Read interrupt status register
     status = ksz8851ReadReg(interface, KSZ8851_REG_ISR);
@@ -457,9 +548,15 @@ error_t ksz8851Init(NetInterface *interface)
        enableMask |= IER_LCIE;
     }
 
+    //RX polling: Has the poll timer expired? (The RX interrupt is disabled in the meantime)
+    pollNow = context->rxPolling && pollTimerExpired(interface);
+
     //Check whether a packet has been received?
-    if(status & ISR_RXIS)
+    if(((status & ISR_RXIS) && !context->rxPolling) || pollNow)
     {
+       //Which threshold has fired? (The status is cleared with the RX interrupt)
+       uint16_t rxqcr = interface->rxCoalesceAdaptive && !pollNow ? ksz8851ReadReg(interface, KSZ8851_REG_RXQCR) : 0;
+
        //ACK (Clear) RX interrupt
        ksz8851WriteReg(interface, KSZ8851_REG_ISR, ISR_RXIS);
 
@@ -468,20 +565,32 @@ error_t ksz8851Init(NetInterface *interface)
        frameCount = MSB(rxfctr);
        TRACE_INFO(" FrameCount: %ld\n", (ULONG)frameCount);
 
-       //Process all pending packets (0-255)
-       while(frameCount > 0)
-       {
-          //Read incoming packet, process with callback...
-          ksz8851ReceivePacket(interface);
+       if (interface->rxCoalesceAdaptive && !pollNow) {
+          ksz8851AdaptRxCoalescing(interface, rxqcr, frameCount);
+       }
+       if (pollNow) {
+          interface->rxPolls++;
+       }
 
-          frameCount--;
+       if (context->pollTimerOpen && interface->rxPollBudget && frameCount >= interface->rxPollBudget) {
+          //Under load: Read one budget of frames, the RX interrupt stays disabled and the timer reads the rest
+          if (!context->rxPolling) {
+             context->rxPolling = true;
+             interface->rxPollSwitches++;
+          }
+          ksz8851DrainRxQueue(interface, (uint8_t)interface->rxPollBudget);
+          startPollTimer(interface);
+       } else {
+          //Process all pending packets (0-255), process with callback... (back in interrupt mode)
+          ksz8851DrainRxQueue(interface, frameCount);
+          context->rxPolling = false;
+          enableMask |= IER_RXIE;
        }
-       enableMask |= IER_RXIE;
     }
 
     //Receiver overruns?
     if (status & ISR_RXOIS) {
-       ((Ksz8851Context*)interface->nicContext)->rxOverrun++;
+       interface->rxOverruns++;
 
        //ACK receiver overrun status by writing "1" to status...
        ksz8851SetBit(interface, KSZ8851_REG_ISR, ISR_RXOIS);
@@ -507,86 +616,186 @@ error_t ksz8851Init(NetInterface *interface)
        enableMask |= IER_TXIE;
     }
 
-    //Re-enable handled interrupts again...
-    ksz8851SetBit(interface, KSZ8851_REG_IER, enableMask);
+    //TXQ has space again? (TXSAIE stays disabled until the next frame does not fit)
+    if (status & ISR_TXSAIS) {
+       ksz8851WriteReg(interface, KSZ8851_REG_ISR, ISR_TXSAIS);
+       txSpaceAvailable = true;
+    }
 
-    //Enable all ints again...
-    //ksz8851EnableInterrupts(interface, enableMask);
-    Enable();
+    //Enable all ints again + re-enable handled interrupts again...
+    ksz8851EnableInterrupts(interface, enableMask);
+
+    //Send the deferred frames (outside of the NIC lock, the upper layer may wait for its locks)
+    if (txSpaceAvailable && interface->txSpaceAvailableFunction) {
+       interface->txSpaceAvailableFunction(interface);
+    }
 
+    KSZ8851_PROFILE_LEAVE();
     //Every thing should be done. No need to call again...
     return false;
  }
 
  /**
-  * @brief Send a packet
+  * @brief KSZ8851 event handler for a software interrupt (bottom half, see NetInterface.bottomHalf)
+  *
+  * A software interrupt can't wait for the NIC lock. But no task runs until it returns: If the lock is
+  * free now, it stays free and the NIC is used without it.
   * @param[in] interface Underlying network interface
-  * @param[in] buffer Multi-part buffer containing the data to send
-  * @param[in] offset Offset to the first data byte
-  * @return Error code
+  * @return false if a task holds the NIC just now (nothing was done, call ksz8851EventHandler from a task)
   **/
-error_t ksz8851SendPacket(NetInterface *interface, uint8_t * buffer, size_t length)
-{
-    error_t result = NO_ERROR;
-    size_t n;
-    Ksz8851TxHeader header;
+ bool ksz8851EventHandlerInterrupt(NetInterface *interface)
+ {
     Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
 
-    TRACE_DEBUG("ksz8851: Send packet (length=%ld)\n", length);
+    //Somebody owns the lock or waits for it?
+    if (context->nicLock.ss_QueueCount != -1) {
+       return false;
+    }
+    context->inSoftInt = true;
+    ksz8851EventHandler(interface);
+    context->inSoftInt = false;
+    return true;
+ }
 
-    //Check the frame length
-    if(length < 46 || length > ETH_MAX_FRAME_SIZE)
-    {
-       TRACE_INFO("ksz8851: Pkt length is not valid (%ld)!\n", length);
-       //Report an error
-       return ERROR_INVALID_LENGTH;
+ /**
+  * @brief Apply the RX interrupt coalescing settings of the interface (rxCoalesce*) to the RX thresholds.
+  *
+  * With one frame per interrupt only the frame count threshold is used (as before). With more frames the
+  * duration timer and the byte count threshold are always enabled too: the timer delivers the frames that
+  * don't reach the frame threshold, the byte threshold protects the RXQ from overruns.
+  * @param[in] interface Underlying network interface
+  **/
+ void ksz8851SetRxCoalescing(NetInterface *interface)
+ {
+    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    uint16_t frames = interface->rxCoalesceFrames;
+    uint16_t enableMask = RXQCR_RXFCTE;
+    uint16_t rxqcr;
+
+    if (frames < 1) {
+       frames = 1;
+    } else if (frames > 255) {
+       frames = 255;
     }
 
-    //Need to exclusive access the NIC registers now, store old IER mask
-    //uint16_t oldIERMask = ksz8851DisableInterrupts(interface);
-    Disable();
+    //Adaptive: start with low latency, the event handler raises the threshold when the packet rate goes up
+    context->rxFrameThreshold    = interface->rxCoalesceAdaptive ? 1 : frames;
+    context->rxFrameThresholdMax = frames;
 
-    //Get the amount of free memory available in the TX FIFO
-    n = ksz8851ReadReg(interface, KSZ8851_REG_TXMIR) & TXMIR_TXMA_MASK;
+    ksz8851DisableInterrupts(interface);
 
-    //Make sure enough memory is available
-    if((length + 8) > n) {
-       TRACE_INFO("######### ksz8851: Not enough space to send packet!\n");
-       result = ERROR_FAILURE;
-       goto end;
+    ksz8851WriteReg(interface, KSZ8851_REG_RXFCTR, context->rxFrameThreshold);
+    if (frames > 1) {
+       ksz8851WriteReg(interface, KSZ8851_REG_RXDBCTR,
+             interface->rxCoalesceBytes ? interface->rxCoalesceBytes : KSZ8851_RX_COALESCE_DEFAULT_BYTES);
+       ksz8851WriteReg(interface, KSZ8851_REG_RXDTTR,
+             interface->rxCoalesceTime ? interface->rxCoalesceTime : KSZ8851_RX_COALESCE_DEFAULT_TIME);
+       enableMask |= RXQCR_RXDBCTE | RXQCR_RXDTTE;
     }
 
-    //The structure seems to be fix little endian always!
-    //Format control word
-    header.controlWord = swap(TX_CTRL_TXIC | (context->frameId++ & TX_CTRL_TXFID));
-    //Total number of bytes to be transmitted
-    header.byteCount = swap(length);
+    //Keep the other bits (the shadow has no status or "one shot" bits)
+    rxqcr = context->rxqcr & ~(RXQCR_RXFCTE | RXQCR_RXDBCTE | RXQCR_RXDTTE | RXQCR_SDA);
+    ksz8851WriteShadowReg(interface, KSZ8851_REG_RXQCR, rxqcr | enableMask);
 
-    //Enable TXQ write access
-    ksz8851SetBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
+    ksz8851EnableInterrupts(interface, 0);
 
-    //Write TX packet header
-    ksz8851WriteFifo(interface, (uint8_t *) &header, sizeof(Ksz8851TxHeader));
+    TRACE_INFO("RX coalescing: frames=%ld bytes=%ld time=%ldus adaptive=%ld\n", (ULONG)frames,
+          (ULONG)interface->rxCoalesceBytes, (ULONG)interface->rxCoalesceTime, (ULONG)interface->rxCoalesceAdaptive);
+ }
 
-    //Write data
-    ksz8851WriteFifo(interface, buffer, length);
+ /**
+  * @brief Apply the checksum offload setting of the interface (checksumOffload): The NIC generates the IP, TCP,
+  * UDP and ICMP checksums of the sent frames and marks received frames with a wrong checksum as invalid
+  * (counted in rxChecksumErrors by ksz8851ReceivePacket).
+  * @param[in] interface Underlying network interface
+  **/
+ void ksz8851SetChecksumOffload(NetInterface *interface)
+ {
+    const uint16_t txcr  = TXCR_TCGIP | TXCR_TCGTCP | TXCR_TCGUDP | TXCR_TCGICMP;
+    const uint16_t rxcr1 = RXCR1_RXIPFCC | RXCR1_RXTCPFCC | RXCR1_RXUDPFCC;
+
+    ksz8851DisableInterrupts(interface);
+    if (interface->checksumOffload) {
+       ksz8851SetBit(interface, KSZ8851_REG_TXCR, txcr);
+       ksz8851SetBit(interface, KSZ8851_REG_RXCR1, rxcr1);
+       ksz8851SetBit(interface, KSZ8851_REG_RXCR2, RXCR2_RXICMPFCC);
+    } else {
+       ksz8851ClearBit(interface, KSZ8851_REG_TXCR, txcr);
+       ksz8851ClearBit(interface, KSZ8851_REG_RXCR1, rxcr1);
+       ksz8851ClearBit(interface, KSZ8851_REG_RXCR2, RXCR2_RXICMPFCC);
+    }
+    ksz8851EnableInterrupts(interface, 0);
 
-    //End TXQ write access
-    ksz8851ClearBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
+    TRACE_INFO("Checksum offload: %ld\n", (ULONG)interface->checksumOffload);
+ }
 
-    //Start transmission
-    ksz8851SetBit(interface, KSZ8851_REG_TXQCR, TXQCR_METFE);
+ /**
+  * @brief Adaptive RX interrupt coalescing: adapts the frame count threshold to the packet rate.
+  * Called by the event handler for every RX interrupt (with disabled interrupts).
+  *
+  * The duration timer is the clock: When the frame threshold was reached before the timer expired and even more
+  * frames were waiting when the interrupt was handled, the rate is higher than threshold/time: the threshold is
+  * doubled (up to rxCoalesceFrames). When the timer expired first, the rate is lower: the threshold is halved
+  * (down to 1, an interrupt per frame).
+  * @param[in] interface Underlying network interface
+  * @param[in] rxqcr RXQCR before the RX interrupt was acknowledged (threshold status bits)
+  * @param[in] frameCount Frames in the RXQ
+  **/
+ void ksz8851AdaptRxCoalescing(NetInterface *interface, uint16_t rxqcr, uint8_t frameCount)
+ {
+    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    uint16_t threshold = context->rxFrameThreshold;
 
-    //Successful processing
-    result = NO_ERROR;
+    if ((rxqcr & RXQCR_RXFCTS) && !(rxqcr & RXQCR_RXDTTS) && frameCount > threshold) {
+       threshold <<= 1;
+       if (threshold > context->rxFrameThresholdMax) {
+          threshold = context->rxFrameThresholdMax;
+       }
+    } else if ((rxqcr & RXQCR_RXDTTS) && !(rxqcr & RXQCR_RXFCTS)) {
+       threshold >>= 1;
+       if (threshold < 1) {
+          threshold = 1;
+       }
+    }
+
+    if (threshold != context->rxFrameThreshold) {
+       context->rxFrameThreshold = threshold;
+       ksz8851WriteReg(interface, KSZ8851_REG_RXFCTR, threshold);
+       TRACE_DEBUG("RX frame threshold: %ld\n", (ULONG)threshold);
+    }
+ }
+
+ /**
+  * @brief Length of a frame to transmit (sum of its segments, at least the minimal Ethernet frame size)
+  **/
+static uint16_t ksz8851TxFrameLength(const NetTxFrame * frame)
+{
+    uint16_t length = 0;
+    uint16_t i;
+
+    for (i = 0; i < frame->segmentCount; i++) {
+       length += frame->segments[i].length;
+    }
+    return length < ETH_MIN_FRAME_SIZE ? ETH_MIN_FRAME_SIZE : length;
+}
+
+ /**
+  * @brief Send a packet
+  * @param[in] interface Underlying network interface
+  * @param[in] buffer Multi-part buffer containing the data to send
+  * @param[in] offset Offset to the first data byte
+  * @return Error code
+  **/
+error_t ksz8851SendPacket(NetInterface *interface, uint8_t * buffer, size_t length)
+{
+    NetTxSegment segment;
 
-end:
+    TRACE_DEBUG("ksz8851: Send packet (length=%ld)\n", length);
 
-   //Enable all NIC ints again...
-   //ksz8851EnableInterrupts(interface, oldIERMask);
-   Enable();
+    segment.data   = buffer;
+    segment.length = length;
 
-   return result;
+    return ksz8851SendPacketV(interface, &segment, 1);
 }
 
 
@@ -606,81 +815,250 @@ error_t ksz8851SendPacketCooked(struct _NetInterface * interface,
       uint8_t * payload,
       size_t payloadLength)
 {
-    Ksz8851TxHeader header;
-    error_t result = NO_ERROR;
-    size_t n;
-    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    NetTxSegment segments[4];
+    //The packet type is written in network byte order
+    uint16_t type = htons(packetType);
 
     TRACE_DEBUG("ksz8851: Send packet (length=%ld, packetType=0x%lx):\n", payloadLength, packetType );
     TRACE_DEBUG("         dst: "); dumpMem((APTR)dst, 6);
     TRACE_DEBUG("         src: "); dumpMem((APTR)src, 6);
     dumpMem(payload, payloadLength);
 
-    //Make the packet bigger when smaller than 46.
-    //TODO: this could cause an enforcer hit when the data is copied because we accessing memory outside the packet...
-    if (payloadLength < 46) {
-       payloadLength = 46;
+    segments[0].data = (uint8_t *)dst;   segments[0].length = 6;
+    segments[1].data = (uint8_t *)src;   segments[1].length = 6;
+    segments[2].data = (uint8_t *)&type; segments[2].length = 2;
+    segments[3].data = payload;          segments[3].length = payloadLength;
+
+    return ksz8851SendPacketV(interface, segments, 4);
+}
+
+/**
+  * @brief Send a packet that is scattered over several segments (e.g. Ethernet header and payload).
+  *
+  * @param[in] interface Underlying network interface
+  * @param[in] segments Parts of the frame
+  * @param[in] count Number of segments
+  * @return Error code
+  **/
+error_t ksz8851SendPacketV(NetInterface *interface, const NetTxSegment * segments, uint16_t count)
+{
+    NetTxFrame frame;
+
+    frame.segments     = segments;
+    frame.segmentCount = count;
+
+    if (ksz8851SendPackets(interface, &frame, 1) == 0) {
+       TRACE_INFO("ksz8851: Not enough space to send packet!!!!!\n");
+       return ERROR_TX_QUEUE_FULL;
     }
+    return frame.error;
+}
 
-    //Need to exclusive access the NIC registers now, store old IER mask
-    //uint16_t oldIERMask = ksz8851DisableInterrupts(interface);
-    Disable();
+/**
+  * @brief Write the segments of a frame as one byte stream into the TX FIFO. An odd byte at the end of a
+  * segment is joined with the first byte of the next one. The frame is padded with zeros up to "length"
+  * and to a DWORD bound.
+  *
+  * @param[in] interface Underlying network interface
+  * @param[in] segments Parts of the frame
+  * @param[in] count Number of segments
+  * @param[in] length Frame length (>= sum of the segment lengths)
+  **/
+static void ksz8851WriteFifoSegments(NetInterface *interface, const NetTxSegment * segments, uint16_t count, uint16_t length)
+{
+    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    union {
+       uint8_t b[2];
+       uint16_t w;
+    } join;
+    bool odd = false;
+    uint16_t written = 0;
+    const uint8_t * data;
+    uint16_t size;
+
+    while (count--) {
+       data = segments->data;
+       size = segments->length;
+       segments++;
+
+       //Complete the word of the last segment
+       if (odd && size) {
+          join.b[1] = *(data++);
+          size--;
+          odd = false;
+          KSZ8851_DATA_WRITE(KSZ8851_IS_BIG_ENDIAN(context) ? join.w : (join.b[0] | (join.b[1] << 8)));
+          written += 2;
+       }
+
+       if (size > 1) {
+          if (((size_t)data & 1) == 0) {
+             written += ksz8851WriteFifoWordAlign(interface, data, size & ~1);
+             data += size & ~1;
+          } else {
+             //Unaligned (after a join): the 68000 can't read words from odd addresses
+             uint16_t words = size >> 1;
+             while (words--) {
+                join.b[0] = *(data++);
+                join.b[1] = *(data++);
+                KSZ8851_DATA_WRITE(KSZ8851_IS_BIG_ENDIAN(context) ? join.w : (join.b[0] | (join.b[1] << 8)));
+             }
+             written += size & ~1;
+          }
+       }
+
+       if (size & 1) {
+          join.b[0] = *data;
+          odd = true;
+       }
+    }
+
+    //Last odd byte, pads
+    if (odd) {
+       join.b[1] = 0;
+       KSZ8851_DATA_WRITE(KSZ8851_IS_BIG_ENDIAN(context) ? join.w : join.b[0]);
+       written += 2;
+    }
+    while (written < length) {
+       KSZ8851_DATA_WRITE(0);
+       written += 2;
+    }
+
+    //Align DMA transfer to DWORD bound, send an additional WORD at the end if needed...
+    if (written & 0x03) {
+       KSZ8851_DATA_WRITE(0);
+    }
+}
+
+/**
+  * @brief Send a batch of packets. All frames that fit into the TX FIFO are written in one DMA phase
+  * (SDA set/clear) and queued for transmission together (one TXQCR_METFE or, with txAutoEnqueue,
+  * automatically when the DMA phase ends). Only the last frame requests a TX interrupt.
+  * Frames shorter than 60 bytes are padded with zeros.
+  *
+  * @param[in] interface Underlying network interface
+  * @param[in,out] frames Frames to send. The error member of the processed frames is set.
+  * @param[in] count Number of frames
+  * @return Number of processed frames (written or skipped because of an invalid length). The frames
+  * behind did not fit into the TX FIFO and were not touched.
+  **/
+uint16_t ksz8851SendPackets(NetInterface *interface, NetTxFrame * frames, uint16_t count)
+{
+    Ksz8851TxHeader header;
+    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    NetTxFrame * frame;
+    size_t n;
+    uint16_t length;
+    uint16_t processed;
+    uint16_t written = 0;
+    uint16_t last = 0;
+    uint16_t needed = 0;
+    uint16_t i;
+    KSZ8851_PROFILE_ENTER(KSZ8851_OP_SEND);
+
+    //Need to exclusive access the NIC registers now
+    ksz8851DisableInterrupts(interface);
+
+    //Follow a changed auto-enqueue setting
+    if (interface->txAutoEnqueue != context->txAutoEnqueue) {
+       context->txAutoEnqueue = interface->txAutoEnqueue;
+       if (context->txAutoEnqueue) {
+          ksz8851SetShadowBit(interface, KSZ8851_REG_TXQCR, TXQCR_AETFE);
+       } else {
+          ksz8851ClearShadowBit(interface, KSZ8851_REG_TXQCR, TXQCR_AETFE);
+       }
+    }
 
     //Get the amount of free memory available in the TX FIFO
     n = ksz8851ReadReg(interface, KSZ8851_REG_TXMIR) & TXMIR_TXMA_MASK;
 
-    //Make sure enough memory is available
-    if((payloadLength + 8) > n) {
-       TRACE_INFO("ksz8851: Not enough space to send packet!!!!!\n");
-       result = ERROR_FAILURE;
-       goto end;
+    //Check the frame lengths and how many frames fit into the TX FIFO
+    for (processed = 0; processed < count; processed++) {
+       frame = &frames[processed];
+       length = ksz8851TxFrameLength(frame);
+       if (length <= ETH_HEADER_SIZE || length > ETH_MAX_FRAME_SIZE) {
+          TRACE_INFO("ksz8851: Pkt length is not valid (%ld)!\n", (ULONG)length);
+          frame->error = ERROR_INVALID_LENGTH;
+          continue;
+       }
+       //Make sure enough memory is available (frame + TX header, DWORD aligned)
+       if ((size_t)(length + 8) > n) {
+          needed = length + 8;
+          break;
+       }
+       n -= ((length + 3) & ~0x03) + sizeof(Ksz8851TxHeader);
+       frame->error = NO_ERROR;
+       last = processed;
+       written++;
     }
 
-    //The header structure always seems to be fixed little endian!
-    //Format control word
-    header.controlWord = swap(TX_CTRL_TXIC | (context->frameId++ & TX_CTRL_TXFID));
-    //Total number of bytes to be transmitted (adding the pads here)
-    header.byteCount   = swap(payloadLength + ETH_HEADER_SIZE);
+    if (written) {
+       //Enable TXQ write access (DMA)
+       ksz8851SetShadowBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
 
-    //Enable TXQ write access (DMA)
-    ksz8851SetBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
-    {
-       //Write TX packet header (4 bytes)
-       ksz8851WriteFifoWordAlign(interface, (uint8_t *)&header, sizeof(Ksz8851TxHeader));
-       //Write "Ethernet Header" (14 bytes)
-       ksz8851WriteFifoWordAlign(interface, (uint8_t *)dst,         6);
-       ksz8851WriteFifoWordAlign(interface, (uint8_t *)src,         6);
-       ksz8851WriteFifoWordAlign(interface, (uint8_t *)&packetType, 2);
-
-       //Write ethernet payload data (maybe aligned to WORDs, added pads...)
-       int realSend = ksz8851WriteFifoWordAlign(interface, payload, payloadLength);
-       realSend += ETH_HEADER_SIZE; //add size of the ethernet head....
-
-       //Align DMA transfer to DWORD bound, send an additional WORD at the end if needed...
-       if (realSend & 0x03) {
-          KSZ8851_DATA_REG = 0;
+       for (i = 0; i <= last; i++) {
+          frame = &frames[i];
+          if (frame->error != NO_ERROR) {
+             continue;
+          }
+          length = ksz8851TxFrameLength(frame);
+
+          //The header structure always seems to be fixed little endian!
+          //Format control word (TX interrupt for the last frame only)
+          header.controlWord = KSZ8851_HTOLE16((i == last ? TX_CTRL_TXIC : 0) | (context->frameId++ & TX_CTRL_TXFID));
+          //Total number of bytes to be transmitted (adding the pads here)
+          header.byteCount   = KSZ8851_HTOLE16(length);
+
+          //Write TX packet header (4 bytes)
+          ksz8851WriteFifoWordAlign(interface, (uint8_t *)&header, sizeof(Ksz8851TxHeader));
+          //Write the frame (incl. pads)
+          ksz8851WriteFifoSegments(interface, frame->segments, frame->segmentCount, length);
        }
-    }
-    //End TXQ write access (DMA ends)
-    ksz8851ClearBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
 
-    //Start transmission
-    ksz8851SetBit(interface, KSZ8851_REG_TXQCR, TXQCR_METFE);
+       //End TXQ write access (DMA ends). With TXQCR_AETFE the frames are queued now.
+       ksz8851ClearShadowBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
 
-    //Successful processing
-    result = NO_ERROR;
+       //Start transmission
+       if (!context->txAutoEnqueue) {
+          ksz8851SetShadowBit(interface, KSZ8851_REG_TXQCR, TXQCR_METFE);
+       }
+    }
 
-end:
+    //The next frame did not fit: Let the NIC tell us when the TXQ has enough space for it
+    //(TX space available interrupt, see txSpaceAvailableFunction)
+    if (needed) {
+       ksz8851WriteReg(interface, KSZ8851_REG_TXNTFSR, needed);
+       ksz8851SetShadowBit(interface, KSZ8851_REG_TXQCR, TXQCR_TXQMAM);
+    }
 
-   //Enable all NIC ints again...
-   //ksz8851EnableInterrupts(interface, oldIERMask);
-   Enable();
+    ksz8851EnableInterrupts(interface, needed ? IER_TXSAIE : 0);
 
-   return result;
+    KSZ8851_PROFILE_COUNT(frames, written);
+    KSZ8851_PROFILE_LEAVE();
+    return processed;
 }
 
  /**
-  * @brief Receive a packet
+  * @brief Releases the current RX frame after its DMA phase was started (error frames and frames the
+  * upper layer does not want): Ends the DMA without the auto dequeue (the frame was not read completely)
+  * and releases the rest of the frame.
+  * @param[in] interface Underlying network interface
+  **/
+ static void ksz8851ReleaseRxFrame(NetInterface *interface)
+ {
+    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    uint16_t rxqcr = context->rxqcr & ~RXQCR_SDA;
+
+    ksz8851WriteReg(interface, KSZ8851_REG_RXQCR, rxqcr & ~RXQCR_ADRFE);
+    ksz8851WriteShadowReg(interface, KSZ8851_REG_RXQCR, rxqcr | RXQCR_RRXEF);
+ }
+
+ /**
+  * @brief Receive a packet (the first frame of the RXQ). NIC must be locked.
+  *
+  * Register sequence per frame: frame pointer reset (RXFDPR from its shadow, required before every RXQ
+  * DMA), SDA set, frame header + frame from the data port, SDA clear (auto dequeue). The frame status and
+  * the byte count are taken from the frame header in the RXQ, not from RXFHSR and RXFHBCR. Error frames
+  * are released right after their header.
   * @param[in] interface Underlying network interface
   * @return Error code
   **/
@@ -690,158 +1068,187 @@ end:
     uint16_t frameStatus;
     Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
     volatile uint16_t dummy UNUSED; //VOLATILE! If not set, compiler would remove read from register! Also assign the reading from register!
-
-    //Read received frame status from RXFHSR
-    frameStatus = ksz8851ReadReg(interface, KSZ8851_REG_RXFHSR);
+    KSZ8851_PROFILE_ENTER(KSZ8851_OP_RECEIVE);
+
+    //Reset QMU RXQ frame pointer to zero
+    //HINT: The endian mode can't read back! So we need to set the complete register with mode bit set or
+    //cleared (from the shadow, the frame pointer bits are always zero there)!
+    ksz8851WriteReg(interface, KSZ8851_REG_RXFDPR, context->rxfdpr);
+    //Enable RXQ read access (start DMA transfer: set bit 3)
+    ksz8851SetShadowBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
+
+    //16 bit NIC: Always read 2 dummy bytes, throw away...
+    dummy = KSZ8851_DATA_READ();
+    //Frame header: status word (like RXFHSR) and byte count (like RXFHBCR). Little endian in the RXQ,
+    //in big endian mode the port delivers the bytes in memory order.
+    frameStatus = KSZ8851_DATA_READ();
+    rxPktLength = KSZ8851_DATA_READ();
+    if (KSZ8851_IS_BIG_ENDIAN(context)) {
+       frameStatus = KSZ8851_LETOH16(frameStatus);
+       rxPktLength = KSZ8851_LETOH16(rxPktLength);
+    }
+    rxPktLength &= RXFHBCR_RXBC_MASK;
 
     TRACE_INFO(" Receiving frame (status=0x%04lx):\n", (ULONG)frameStatus);
 
-   //Make sure the frame is valid (bit 15 must be 1)
-   if (0 == (frameStatus & RXFHSR_RXFV)) {
-
-      TRACE_INFO(" Pkt is not valid! ");
-
-      if (frameStatus & (
-              RXFHSR_RXMR         //MII Error
-            | RXFHSR_RXFTL        //Frame too long > 2000
-            | RXFHSR_RXRF         //Runt Frame Error
-            | RXFHSR_RXCE         //CRC Error
-            | RXFHSR_RXUDPFCS     //UDP crc error
-            | RXFHSR_RXTCPFCS     //TCP crc error
-            | RXFHSR_RXIPFCS      //IP crc error
-            | RXFHSR_RXICMPFCS    //ICMP crc error
-      )) {
-         TRACE_INFO(" Pkt is error packet!\n");
-
-         //Release the current error frame from RXQ
-         ksz8851SetBit(interface, KSZ8851_REG_RXQCR, RXQCR_RRXEF);
+   //Make sure the frame is valid (bit 15 must be 1) and the frame size is acceptable (the pkt contains
+   //the 4 byte checksum, so it could be 1514 + 4 bytes size!)
+   if (0 == (frameStatus & RXFHSR_RXFV) || rxPktLength == 0 || rxPktLength > (ETH_MAX_FRAME_SIZE + 4)) {
+
+      TRACE_INFO(" Pkt is not valid (status=0x%04lx, size=%ld)!\n", (ULONG)frameStatus, (ULONG)rxPktLength);
+
+      interface->rxBadFrames++;
+      //Checksum offload: the NIC marks frames with a wrong checksum as invalid
+      if (frameStatus & RXFHSR_RXIPFCS) {
+         interface->rxChecksumErrors[NET_CHECKSUM_IP]++;
+      }
+      if (frameStatus & RXFHSR_RXTCPFCS) {
+         interface->rxChecksumErrors[NET_CHECKSUM_TCP]++;
+      }
+      if (frameStatus & RXFHSR_RXUDPFCS) {
+         interface->rxChecksumErrors[NET_CHECKSUM_UDP]++;
+      }
+      if (frameStatus & RXFHSR_RXICMPFCS) {
+         interface->rxChecksumErrors[NET_CHECKSUM_ICMP]++;
       }
 
-      TRACE_INFO("\n");
+      //Release the current error frame from RXQ
+      ksz8851ReleaseRxFrame(interface);
 
       //Report an error
+      KSZ8851_PROFILE_LEAVE();
       return ERROR_INVALID_PACKET;
    }
 
-   //Read received frame byte size from RXFHBCR (Frame size + 4 bytes CRC)
-   rxPktLength = ksz8851ReadReg(interface, KSZ8851_REG_RXFHBCR) & RXFHBCR_RXBC_MASK;
-
-   //Ensure the frame size is acceptable (the pkt contains the 4 byte checksum, so it could be 1514 + 4 bytes size!)
-   if (rxPktLength > 0 && rxPktLength <= (ETH_MAX_FRAME_SIZE + 4)) {
-
-      //Reset QMU RXQ frame pointer to zero
-      //HINT: The endian mode can't read back! So we need to set the complete register with mode bit set or
-      //cleared!
-      uint16_t val = context->isInBigEndianMode ? (RXFDPR_RXFPAI | RXFDPR_EMS) : (RXFDPR_RXFPAI);
-      ksz8851WriteReg(interface, KSZ8851_REG_RXFDPR, val);
-      //Enable RXQ read access (start DMA transfer: set bit 3)
-      ksz8851SetBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
-
-      //16 bit NIC: Always read 2 dummy bytes, throw away...
-      dummy = KSZ8851_DATA_REG;
-      //Read (and ignore) packet header:
-      dummy = KSZ8851_DATA_REG; //Status Word
-      dummy = KSZ8851_DATA_REG; //byte count
-
-      //TODO: There is a problem: To fulfill Amiga Sana2 device standard I need "raw packets" too which includes all infos about the packet.
-      //But before I can read the whole packet, I have no clue that type it is. I can't discard the packet.
-      //I have to copy twice the packet.
-
-      //Read Ethernet packet:
-      // - 2 dummy bytes,
-      // - 6 bytes destination,
-      // - 6 bytes source,
-      // - 2 bytes packet type
-      // - X bytes data payload
-      // - 4 bytes checksum
-      ksz8851ReadFifo(interface, context->rxBuffer, rxPktLength );
-
-      //End RXQ read access
-      ksz8851ClearBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
-
-      //The ints are disabled. During delivering the packet, enable ints again
-      Enable();
-
-      //Pass the packet to the upper layer
-      if (interface->onPacketReceived) {
-         //deliver only the Ethernet frame (offset +2) and payload without trailing checksum (len -4)
-         interface->onPacketReceived(context->rxBuffer+2, rxPktLength - 2 - 4);
+   //Read Ethernet packet:
+   // - 2 dummy bytes,
+   // - 6 bytes destination,
+   // - 6 bytes source,
+   // - 2 bytes packet type
+   // - X bytes data payload
+   // - 4 bytes checksum
+   //
+   //The 2 dummy bytes and the Ethernet header are read first. With that the upper layer can
+   //decide where the payload should go before it is read from the FIFO.
+   RxDeliveryMode mode = RX_DELIVER_COPY;
+   uint8_t * payloadBuffer = NULL;
+   uint16_t frameLength = rxPktLength - 2 - 4;
+
+   if (rxPktLength >= KSZ8851_RX_HEADER_SIZE + 4 && interface->onPacketHeader) {
+      ksz8851ReadFifo(interface, context->rxBuffer, KSZ8851_RX_HEADER_SIZE);
+      mode = interface->onPacketHeader(interface, context->rxBuffer + 2, frameLength, &payloadBuffer);
+
+      if (mode == RX_DELIVER_DIRECT) {
+         //Payload straight into the buffer of the upper layer, CRC and DWORD padding are thrown away
+         uint16_t payloadLength = frameLength - ETH_HEADER_SIZE;
+         ksz8851ReadFifoBytes(interface, payloadBuffer, payloadLength);
+         ksz8851SkipFifo(interface, (((rxPktLength + 3) & ~0x03) - KSZ8851_RX_HEADER_SIZE - ((payloadLength + 1) & ~1)) >> 1);
+      } else if (mode == RX_DELIVER_DISCARD) {
+         ksz8851ReleaseRxFrame(interface);
+         KSZ8851_PROFILE_COUNT(frames, 1);
+         KSZ8851_PROFILE_LEAVE();
+         return NO_ERROR;
+      } else {
+         ksz8851ReadFifo(interface, context->rxBuffer + KSZ8851_RX_HEADER_SIZE, rxPktLength - KSZ8851_RX_HEADER_SIZE);
       }
-
-      //Disable Ints again for the rest of reading packets...
-      Disable();
-
-      //Valid packet received
-      return NO_ERROR;
-
    } else {
-      TRACE_INFO(" Pkt size is invalid! (size=%ld)\n", (ULONG)rxPktLength);
+      ksz8851ReadFifo(interface, context->rxBuffer, rxPktLength );
+   }
 
-      //Release the current error frame from RXQ
-      ksz8851SetBit(interface, KSZ8851_REG_RXQCR, RXQCR_RRXEF);
+   //End RXQ read access
+   ksz8851ClearShadowBit(interface, KSZ8851_REG_RXQCR, RXQCR_SDA);
 
-      //Report an error
-      return ERROR_INVALID_PACKET;
+   //The NIC stays locked while the packet is delivered (the next frames are read in the same lock)
+   //Pass the packet to the upper layer
+   if (mode == RX_DELIVER_DIRECT) {
+      interface->onPacketPayloadReceived(interface, context->rxBuffer + 2, frameLength);
+   } else if (interface->onPacketReceived) {
+      //deliver only the Ethernet frame (offset +2) and payload without trailing checksum (len -4)
+      interface->onPacketReceived(interface, context->rxBuffer + 2, frameLength);
    }
+
+   //Valid packet received
+   KSZ8851_PROFILE_COUNT(frames, 1);
+   KSZ8851_PROFILE_LEAVE();
+   return NO_ERROR;
 }
 
+ /**
+  * @brief Drains the RXQ: Receives "frameCount" frames (from RXFCTR, read once by the caller) in one go.
+  * NIC must be locked.
+  * @param[in] interface Underlying network interface
+  * @param[in] frameCount Frames in the RXQ
+  * @return Number of valid frames
+  **/
+ uint16_t ksz8851DrainRxQueue(NetInterface *interface, uint8_t frameCount)
+ {
+    uint16_t received = 0;
+
+    while (frameCount > 0) {
+       if (ksz8851ReceivePacket(interface) == NO_ERROR) {
+          received++;
+       }
+       frameCount--;
+    }
+    return received;
+ }
 
  /**
   * @brief Configure multicast MAC address filtering
+  *
+  * The hash table (MAHTR0-3) gets a bit for each valid entry (refCount > 0). A hash filter also passes the
+  * frames of other groups with the same hash: the upper layer has to check the destination address. Without
+  * a filter (NULL) the NIC receives all multicast frames (RXCR1_RXMAFMA), for more groups than fit into the
+  * hash table without too many collisions (MAC_MULTICAST_FILTER_SIZE).
+  * The filter is kept in the context and written again by ksz8851Init.
   * @param[in] interface Underlying network interface
+  * @param[in] filter Multicast groups to receive or NULL for all multicast frames
+  * @param[in] fileEntries Number of entries in filter
   * @return Error code
   **/
-#if 1
- error_t ksz8851SetMulticastFilter(NetInterface *interface, MacFilterEntry filter[], uint8_t fileEntries)
+ error_t ksz8851SetMulticastFilter(NetInterface *interface, const MacFilterEntry filter[], uint8_t fileEntries)
  {
+    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
     uint_t i;
     uint_t k;
-    uint32_t crc;
-    uint16_t hashTable[4];
-    MacFilterEntry *entry;
 
     //Debug message
     TRACE_DEBUG("Updating KSZ8851 hash table...\r\n");
 
     //Clear hash table
-    memset(hashTable, 0, sizeof(hashTable));
+    memset(context->multicastHash, 0, sizeof(context->multicastHash));
+    context->allMulticast = (filter == NULL);
 
     //The MAC filter table contains the multicast MAC addresses
     //to accept when receiving an Ethernet frame
-    for(i = 0; i < fileEntries; i++)
+    for(i = 0; filter && i < fileEntries; i++)
     {
-       //Point to the current entry
-       entry = &filter[i];
-
        //Valid entry?
-       if(entry->refCount > 0)
+       if(filter[i].refCount > 0)
        {
-          //Compute CRC over the current MAC address
-          crc = ksz8851CalcCrc(&entry->addr, sizeof(MacAddr));
           //Calculate the corresponding index in the table
-          k = (crc >> 26) & 0x3F;
+          k = ksz8851MulticastHash(&filter[i].addr);
           //Update hash table contents
-          hashTable[k / 16] |= (1 << (k % 16));
+          context->multicastHash[k / 16] |= (1 << (k % 16));
        }
     }
 
-    //Write the hash table to the KSZ8851 controller
-    ksz8851WriteReg(interface, KSZ8851_REG_MAHTR0, hashTable[0]);
-    ksz8851WriteReg(interface, KSZ8851_REG_MAHTR1, hashTable[1]);
-    ksz8851WriteReg(interface, KSZ8851_REG_MAHTR2, hashTable[2]);
-    ksz8851WriteReg(interface, KSZ8851_REG_MAHTR3, hashTable[3]);
+    ksz8851DisableInterrupts(interface);
+    ksz8851WriteMulticastFilter(interface);
+    ksz8851EnableInterrupts(interface, 0);
 
     //Debug message
-    TRACE_DEBUG("  MAHTR0 = %04" PRIX16 "\r\n", ksz8851ReadReg(interface, KSZ8851_REG_MAHTR0));
-    TRACE_DEBUG("  MAHTR1 = %04" PRIX16 "\r\n", ksz8851ReadReg(interface, KSZ8851_REG_MAHTR1));
-    TRACE_DEBUG("  MAHTR2 = %04" PRIX16 "\r\n", ksz8851ReadReg(interface, KSZ8851_REG_MAHTR2));
-    TRACE_DEBUG("  MAHTR3 = %04" PRIX16 "\r\n", ksz8851ReadReg(interface, KSZ8851_REG_MAHTR3));
+    TRACE_DEBUG("  MAHTR0 = %04" PRIX16 "\r\n", (ULONG)context->multicastHash[0]);
+    TRACE_DEBUG("  MAHTR1 = %04" PRIX16 "\r\n", (ULONG)context->multicastHash[1]);
+    TRACE_DEBUG("  MAHTR2 = %04" PRIX16 "\r\n", (ULONG)context->multicastHash[2]);
+    TRACE_DEBUG("  MAHTR3 = %04" PRIX16 "\r\n", (ULONG)context->multicastHash[3]);
+    TRACE_DEBUG("  all multicast = %ld\r\n", (ULONG)context->allMulticast);
 
     //Successful processing
     return NO_ERROR;
  }
-#endif
 
+#ifndef KSZ8851_FIXED_BIG_ENDIAN
  /**
   * Own read 16 bit registers
   * @param ks
@@ -850,13 +1257,7 @@ end:
  uint16_t ksz8851ReadReg(NetInterface *interface, uint8_t offset)
  {
     Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
-
-    if (offset & 2) {
-       KSZ8851_CMD_REG = offset | (context->isInBigEndianMode ? ( KSZ8851_CMD_B0 | KSZ8851_CMD_B1) : (KSZ8851_CMD_B2 | KSZ8851_CMD_B3));
-    } else {
-       KSZ8851_CMD_REG = offset | (context->isInBigEndianMode ? ( KSZ8851_CMD_B2 | KSZ8851_CMD_B3) : (KSZ8851_CMD_B0 | KSZ8851_CMD_B1));
-    }
-    return KSZ8851_DATA_REG;
+    return ksz8851ReadRegMode(offset, context->isInBigEndianMode);
  }
 
  /**
@@ -867,14 +1268,9 @@ end:
  void ksz8851WriteReg(NetInterface *interface, uint8_t offset, uint16_t value)
  {
     Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
-
-    if (offset & 2) {
-       KSZ8851_CMD_REG = offset | (context->isInBigEndianMode ? ( KSZ8851_CMD_B0 | KSZ8851_CMD_B1) : (KSZ8851_CMD_B2 | KSZ8851_CMD_B3));
-    } else {
-       KSZ8851_CMD_REG = offset | (context->isInBigEndianMode ? ( KSZ8851_CMD_B2 | KSZ8851_CMD_B3) : (KSZ8851_CMD_B0 | KSZ8851_CMD_B1));
-    }
-    KSZ8851_DATA_REG = value;
+    ksz8851WriteRegMode(offset, value, context->isInBigEndianMode);
  }
+#endif
 
  /**
   * @brief Write KSZ8851 register
@@ -995,28 +1391,19 @@ end:
      Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
 
      //Align count to one "Word"
-     register uint16_t sizeInWord = (lengthInBytes + 1) >> 1;
-
-     if (context->isInBigEndianMode) {
-        //BE mode:
-        //copy in BE16 mode...which is faster because we do not swap bytes
-        register uint16_t * wordData = (uint16_t*)data;
-        while (sizeInWord--) {
-           KSZ8851_DATA_REG = *(wordData++);
-        }
+     uint16_t sizeInWord = (lengthInBytes + 1) >> 1;
+     uint16_t writtenBytes = sizeInWord << 1;
 
+     if (KSZ8851_IS_BIG_ENDIAN(context)) {
+        //BE mode: no byte swapping for 68k processor
+        ksz8851FifoWriteWords((const uint16_t*)data, sizeInWord);
      } else {
-        //LE mode: (twisting)
-        register uint16_t val;
-        while (sizeInWord--) {
-           val = *(data++);
-           val |= ((*(data++)) << 8);
-           KSZ8851_DATA_REG = val;
-        }
+        //LE mode: (swapping bytes)
+        ksz8851FifoWriteWordsSwapped((const uint16_t*)data, sizeInWord);
      }
 
      //Return written bytes...
-     return (sizeInWord << 1) & ~0x01;
+     return writtenBytes;
   }
 
  /**
@@ -1031,25 +1418,14 @@ end:
     Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
 
     //Align the size to DWORDs...
-    register uint16_t sizeInWord = ((length + 3) & ~0x03) >> 1;
-
-
-    if (context->isInBigEndianMode) {
-       //BE mode:
-       //copy in BE16 mode...no byte swapping for 68k processor
-       register uint16_t * wordData = (uint16_t*)data;
-       while (sizeInWord--) {
-          KSZ8851_DATA_REG = *(wordData++);
-       }
+    uint16_t sizeInWord = ((length + 3) & ~0x03) >> 1;
 
+    if (KSZ8851_IS_BIG_ENDIAN(context)) {
+       //BE mode: no byte swapping for 68k processor
+       ksz8851FifoWriteWords((const uint16_t*)data, sizeInWord);
     } else {
        //LE mode: (swapping bytes)
-       register uint16_t val;
-       while (sizeInWord--) {
-          val = *(data++);
-          val |= ((*(data++)) << 8);
-          KSZ8851_DATA_REG = val;
-       }
+       ksz8851FifoWriteWordsSwapped((const uint16_t*)data, sizeInWord);
     }
  }
 
@@ -1070,30 +1446,59 @@ end:
   * @param[in] length Number of data to read
   **/
 void ksz8851ReadFifo(NetInterface *interface, uint8_t *data, size_t length) {
-   register uint16_t value;
    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
 
    //Size in WORDs that are DWORD aligned!
-   register uint16_t sizeInWord = ((length + 3) & ~0x03) >> 1;
+   uint16_t sizeInWord = ((length + 3) & ~0x03) >> 1;
 
    //Data phase:
-   if (context->isInBigEndianMode) {
+   if (KSZ8851_IS_BIG_ENDIAN(context)) {
       //copy in BE16 mode...which is faster because we do not mix the words
-      register uint16_t * wordData = (uint16_t*)data;
-      while (sizeInWord--) {
-         *(wordData++) = KSZ8851_DATA_REG;
-      }
-
+      ksz8851FifoReadWords((uint16_t*)data, sizeInWord);
    } else {
       //Copy LE Mode (twisting bytes)
-      while (sizeInWord--) {
-         value = KSZ8851_DATA_REG;
-         *(data++) = value & 0xFF;
-         *(data++) = (value >> 8) & 0xFF;
+      ksz8851FifoReadWordsSwapped((uint16_t*)data, sizeInWord);
+   }
+}
+
+
+ /**
+  * @brief Read exactly "length" bytes from the RX FIFO (no DWORD alignment, the last byte of an odd
+  * length is taken from the low byte lane of the last word)
+  * @param[in] interface Underlying network interface
+  * @param[in] data Buffer where to store the incoming data (word aligned)
+  * @param[in] length Number of bytes to read
+  **/
+void ksz8851ReadFifoBytes(NetInterface *interface, uint8_t *data, size_t length) {
+   uint16_t value; //not "register": the first byte in memory is taken from it
+   Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+   uint16_t sizeInWord = length >> 1;
+
+   if (KSZ8851_IS_BIG_ENDIAN(context)) {
+      ksz8851FifoReadWords((uint16_t*)data, sizeInWord);
+      data += length & ~1;
+      if (length & 1) {
+         value = KSZ8851_DATA_READ();
+         *data = *(uint8_t*)&value;
+      }
+   } else {
+      ksz8851FifoReadWordsSwapped((uint16_t*)data, sizeInWord);
+      data += length & ~1;
+      if (length & 1) {
+         *data = KSZ8851_DATA_READ() & 0xFF;
       }
    }
 }
 
+/**
+  * @brief Read and throw away words from the RX FIFO
+  * @param[in] interface Underlying network interface
+  * @param[in] sizeInWord Number of words to skip
+  **/
+void ksz8851SkipFifo(NetInterface *interface, uint16_t sizeInWord) {
+   ksz8851FifoSkipWords(sizeInWord);
+}
+
 
  /**
   * @brief Set bit field
@@ -1130,40 +1535,87 @@ void ksz8851ReadFifo(NetInterface *interface, uint8_t *data, size_t length) {
  }
 
  /**
-  * @brief CRC calculation
+  * @brief Compares the register shadows (see ksz8851WriteShadowReg) with the NIC. Status bits, "one shot" bits,
+  * the armed TXQMAM (cleared by the NIC) and the RXFDPR frame pointer and EMS bit (can't be read back) are
+  * not compared. Debug builds check the shadows every time the NIC is unlocked. NIC must be locked.
+  * @param[in] interface Underlying network interface
+  * @return Number of registers that differ from their shadow
+  **/
+ uint16_t ksz8851CheckShadowRegs(NetInterface *interface)
+ {
+    static const struct {
+       uint8_t address;
+       uint16_t mask;
+       const char * name;
+    } checks[] = {
+       { KSZ8851_REG_IER,    0xffff,                                                     "IER" },
+       { KSZ8851_REG_RXQCR,  (uint16_t)~(RXQCR_RRXEF | RXQCR_RXFCTS | RXQCR_RXDBCTS | RXQCR_RXDTTS), "RXQCR" },
+       { KSZ8851_REG_TXQCR,  (uint16_t)~(TXQCR_METFE | TXQCR_TXQMAM),                    "TXQCR" },
+       { KSZ8851_REG_RXFDPR, RXFDPR_RXFPAI,                                              "RXFDPR" },
+    };
+    Ksz8851Context *context = (Ksz8851Context *)interface->nicContext;
+    uint16_t errors = 0;
+    uint16_t value;
+    uint16_t shadow;
+    uint16_t i;
+
+    for (i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+       value  = ksz8851ReadReg(interface, checks[i].address) & checks[i].mask;
+       shadow = *ksz8851ShadowReg(context, checks[i].address) & checks[i].mask;
+       if (value != shadow) {
+          TRACE_INFO("ksz8851: shadow of %s is wrong (NIC=0x%04lx, shadow=0x%04lx)!\n", checks[i].name,
+                (ULONG)value, (ULONG)shadow);
+          errors++;
+       }
+    }
+    return errors;
+ }
+
+ /**
+  * @brief CRC calculation (Ethernet CRC-32, table driven: one lookup per nibble)
+  *
+  * The CRC is processed LSB first like the bits on the wire (reflected polynomial 0xEDB88320). The result
+  * is the CRC register before the final inversion, so its bit 0 is bit 31 of the MSB first CRC.
   * @param[in] data Pointer to the data over which to calculate the CRC
   * @param[in] length Number of bytes to process
   * @return Resulting CRC value
   **/
-
  uint32_t ksz8851CalcCrc(const void *data, size_t length)
  {
-    uint_t i;
-    uint_t j;
-
+    static const uint32_t crcTable[16] = {
+       0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+       0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
     //Point to the data over which to calculate the CRC
-    const uint8_t *p = (uint8_t *) data;
+    const uint8_t *p = (const uint8_t *) data;
     //CRC preset value
     uint32_t crc = 0xFFFFFFFF;
 
-    //Loop through data
-    for(i = 0; i < length; i++)
-    {
-       //The message is processed bit by bit
-       for(j = 0; j < 8; j++)
-       {
-          //Update CRC value
-          if(((crc >> 31) ^ (p[i] >> j)) & 0x01)
-             crc = (crc << 1) ^ 0x04C11DB7;
-          else
-             crc = crc << 1;
-       }
+    while (length--) {
+       crc = (crc >> 4) ^ crcTable[(crc ^ *p) & 0x0F];
+       crc = (crc >> 4) ^ crcTable[(crc ^ (*p++ >> 4)) & 0x0F];
     }
-
-    //Return CRC value
     return crc;
  }
 
+ /**
+  * @brief Index of a multicast address in the 64 bit hash table (MAHTR0-3): the upper 6 bits of the MSB first
+  * CRC, which are the lower 6 bits of ksz8851CalcCrc in reverse order.
+  * @param[in] address Multicast MAC address
+  * @return Bit number in the hash table (0..63)
+  **/
+ uint8_t ksz8851MulticastHash(const MacAddr *address)
+ {
+    uint32_t crc = ksz8851CalcCrc(address, sizeof(MacAddr));
+    uint8_t index = 0;
+    uint8_t i;
+
+    for (i = 0; i < 6; i++) {
+       index = (index << 1) | ((crc >> i) & 0x01);
+    }
+    return index;
+ }
+
  /**
   * Dump registers in 16 bit mode
   * @param ks
@@ -1221,11 +1673,11 @@ void ksz8851ReadFifo(NetInterface *interface, uint8_t *data, size_t length) {
   * @param addr
   */
  static void ksz8851SetNetworkAddress(NetInterface * interface, MacAddr * addr) {
-    Disable();
+    ksz8851DisableInterrupts(interface);
     ksz8851WriteReg(interface, KSZ8851_REG_MARH, htons(addr->w[0]));
     ksz8851WriteReg(interface, KSZ8851_REG_MARM, htons(addr->w[1]));
     ksz8851WriteReg(interface, KSZ8851_REG_MARL, htons(addr->w[2]));
-    Enable();
+    ksz8851EnableInterrupts(interface, 0);
  }
 
  static bool macInit = false;
@@ -1260,15 +1712,26 @@ void ksz8851ReadFifo(NetInterface *interface, uint8_t *data, size_t length) {
        .getUsedSignalNumber      = ksz8851GetUsedSignalNumber,
        .reset                    = ksz8851SoftReset,
        .processEvents            = ksz8851EventHandler,
+       .processEventsInterrupt   = ksz8851EventHandlerInterrupt,
        .sendPacketPossible       = ksz8851SendPacketPossible,
        .sendPacket               = ksz8851SendPacket,
        .sendPacketCooked         = ksz8851SendPacketCooked,
+       .sendPacketV              = ksz8851SendPacketV,
+       .sendPackets              = ksz8851SendPackets,
        .getDefaultNetworkAddress = ksz8851GetStationAddress,
        .setNetworkAddress        = ksz8851SetNetworkAddress,
+       .setMulticastFilter       = ksz8851SetMulticastFilter,
        .getConfigFileName        = ksz8851GetConfigFileName,
+       .updateRxCoalescing       = ksz8851SetRxCoalescing,
+       .updateChecksumOffload    = ksz8851SetChecksumOffload,
        .nicContext = (Ksz8851Context*)&context,
  };
 
  extern NetInterface * initModule() {
+    //Only once: The module is "initialized" again when the device goes offline (lock could be in use)
+    if (!context.nicLockInitialized) {
+       InitSemaphore(&context.nicLock);
+       context.nicLockInitialized = true;
+    }
     return &driverInterface;
  }
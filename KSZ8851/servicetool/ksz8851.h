@@ -13,6 +13,10 @@
 
 #include <exec/interrupts.h>
 #include <exec/tasks.h>
+#include <exec/semaphores.h>
+#include <exec/ports.h>
+#include <exec/io.h>
+#include <devices/timer.h>
 #include <hardware/intbits.h>
 
 #include <stdint.h>
@@ -23,6 +27,7 @@
 #include <netinet/in.h>
 
 #include "../include/hardware-interface.h"
+#include "profile.h"
 
 //get the highest byte of 16 bit value only (BE??)
 #define MSB(x) (((x) >> 8) & 0xff)
@@ -41,6 +46,15 @@ typedef struct
 
 uint16_t swap(uint16_t);
 
+//The TX header in the QMU is little endian
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+   #define KSZ8851_HTOLE16(x) (x)
+#else
+   #define KSZ8851_HTOLE16(x) swap(x)
+#endif
+//The RX frame header in the QMU is little endian too
+#define KSZ8851_LETOH16(x) KSZ8851_HTOLE16(x)
+
 #define bool_t bool
 
 
@@ -52,6 +66,19 @@ uint16_t swap(uint16_t);
 
 #define ETH_MAX_FRAME_SIZE 1518
 #define ETH_HEADER_SIZE 14
+#define ETH_MIN_FRAME_SIZE 60
+
+//Part of a RXQ frame that is read before the upper layer decides about the delivery:
+//2 dummy bytes (IP header two-byte offset) + Ethernet header
+#define KSZ8851_RX_HEADER_SIZE (2 + ETH_HEADER_SIZE)
+
+//RX interrupt coalescing defaults when more than one frame per interrupt is configured: A frame waits
+//at most this time (microseconds) and the RXQ (12 KB) is never filled more than the byte threshold.
+#define KSZ8851_RX_COALESCE_DEFAULT_TIME  500
+#define KSZ8851_RX_COALESCE_DEFAULT_BYTES (6 * 1024)
+
+//Time between two RX polls (microseconds) when NetInterface.rxPollInterval is 0
+#define KSZ8851_RX_POLL_DEFAULT_INTERVAL  500
 
  // -------------
 
@@ -60,6 +87,11 @@ uint16_t swap(uint16_t);
 #define RXFDPR_EMS            (1 << 11)   /* KSZ8851-16MLL */
 
 
+ //Host build: The ports are accessed through the chip simulator
+ #ifdef KSZ8851_SIMULATOR
+    #include "sim/ksz8851sim.h"
+ #endif
+
  //KSZ8851 data register
  #ifndef KSZ8851_DATA_REG
     #define KSZ8851_DATA_REG *((volatile uint16_t *) ETHERNET_BASE_ADDRESS)
@@ -70,6 +102,28 @@ uint16_t swap(uint16_t);
     #define KSZ8851_CMD_REG *((volatile uint16_t *) (ETHERNET_BASE_ADDRESS + 2))
  #endif
 
+ //The bus accesses of the ports
+ #ifndef KSZ8851_BUS_CMD_WRITE
+    #define KSZ8851_BUS_CMD_WRITE(cmd)     (KSZ8851_CMD_REG = (cmd))
+ #endif
+ #ifndef KSZ8851_BUS_DATA_READ
+    #define KSZ8851_BUS_DATA_READ()        (KSZ8851_DATA_REG)
+ #endif
+ #ifndef KSZ8851_BUS_DATA_WRITE
+    #define KSZ8851_BUS_DATA_WRITE(value)  (KSZ8851_DATA_REG = (value))
+ #endif
+
+ //All port accesses go through these macros (counted by the profiler, see profile.h)
+ #ifdef KSZ8851_PROFILE
+    #define KSZ8851_CMD_WRITE(cmd)     (KSZ8851_PROFILE_COUNT(cmdWrites, 1), KSZ8851_BUS_CMD_WRITE(cmd))
+    #define KSZ8851_DATA_READ()        (KSZ8851_PROFILE_COUNT(dataReads, 1), KSZ8851_BUS_DATA_READ())
+    #define KSZ8851_DATA_WRITE(value)  (KSZ8851_PROFILE_COUNT(dataWrites, 1), KSZ8851_BUS_DATA_WRITE(value))
+ #else
+    #define KSZ8851_CMD_WRITE(cmd)     KSZ8851_BUS_CMD_WRITE(cmd)
+    #define KSZ8851_DATA_READ()        KSZ8851_BUS_DATA_READ()
+    #define KSZ8851_DATA_WRITE(value)  KSZ8851_BUS_DATA_WRITE(value)
+ #endif
+
  //Device ID
  #define KSZ8851_REV_A2_ID        0x8870
  #define KSZ8851_REV_A3_ID        0x8872
@@ -86,6 +140,44 @@ uint16_t swap(uint16_t);
 #define KSZ8851_CMD_B2        0x4000
 #define KSZ8851_CMD_B3        0x8000
 
+ //Bus mode of the chip fixed at compile time (make FIXED_BIG_ENDIAN=1): ksz8851Init always switches the chip
+ //to big endian mode, so the register and FIFO accesses don't need to check the mode at runtime. The command
+ //words of register accesses become constants then. Only the probe and reset path work in both modes.
+ #ifdef KSZ8851_FIXED_BIG_ENDIAN
+    #define KSZ8851_IS_BIG_ENDIAN(context) ((void)(context), true)
+ #else
+    #define KSZ8851_IS_BIG_ENDIAN(context) ((context)->isInBigEndianMode)
+ #endif
+
+ /**
+  * Command word of a 16 bit register access. In big endian mode the byte enables are mirrored too.
+  */
+ static inline uint16_t ksz8851RegCmd(uint8_t offset, bool bigEndian)
+ {
+    if (offset & 2) {
+       return offset | (bigEndian ? (KSZ8851_CMD_B0 | KSZ8851_CMD_B1) : (KSZ8851_CMD_B2 | KSZ8851_CMD_B3));
+    }
+    return offset | (bigEndian ? (KSZ8851_CMD_B2 | KSZ8851_CMD_B3) : (KSZ8851_CMD_B0 | KSZ8851_CMD_B1));
+ }
+
+ static inline uint16_t ksz8851ReadRegMode(uint8_t offset, bool bigEndian)
+ {
+    KSZ8851_CMD_WRITE(ksz8851RegCmd(offset, bigEndian));
+    return KSZ8851_DATA_READ();
+ }
+
+ static inline void ksz8851WriteRegMode(uint8_t offset, uint16_t value, bool bigEndian)
+ {
+    KSZ8851_CMD_WRITE(ksz8851RegCmd(offset, bigEndian));
+    KSZ8851_DATA_WRITE(value);
+ }
+
+ #ifdef KSZ8851_FIXED_BIG_ENDIAN
+    //Inlined: the command word of a constant register offset is a constant
+    #define ksz8851ReadReg(interface, offset)         ((void)(interface), ksz8851ReadRegMode((offset), true))
+    #define ksz8851WriteReg(interface, offset, value) ((void)(interface), ksz8851WriteRegMode((offset), (value), true))
+ #endif
+
 
  //KSZ8851 registers
  #define KSZ8851_REG_CCR          0x08
@@ -461,10 +553,30 @@ uint16_t swap(uint16_t);
     struct Task * signalTask;          //Amiga Signal task to signal
     ULONG sigNumber;                   //Number of the signal to signal task
     ULONG signalCounter;               //Number of signaled events to the task...
-    ULONG rxOverrun;                   //Overrun counter
     bool isInBigEndianMode;            //NIC is in big endian mode?
     uint_t frameId;                    //Identify a frame and its associated status
     uint8_t intDisabledCounter;        //if >0 all NIC ints are disabled...
+    uint16_t ierMask;                  //IER value to restore when the NIC ints are enabled again
+    struct SignalSemaphore nicLock;    //Exclusive access of a task to the NIC registers and FIFOs
+    bool nicLockInitialized;
+    bool inSoftInt;                    //The NIC is locked by the software interrupt (without nicLock)
+    uint16_t rxFrameThreshold;         //Current RX frame count threshold (RXFCTR)
+    uint16_t rxFrameThresholdMax;      //Upper limit of the threshold (adaptive coalescing)
+    bool txAutoEnqueue;                //TXQCR_AETFE is set (TX frames are queued when SDA is cleared)
+    //Shadows of the control registers that are changed several times per frame: bits are set or cleared
+    //with a single write (no read before). Only changed by ksz8851WriteShadowReg & co. (NIC locked or ISR).
+    uint16_t ier;                      //IER as written to the NIC (0 while the NIC is locked)
+    uint16_t rxqcr;                    //RXQCR without status bits and RRXEF
+    uint16_t txqcr;                    //TXQCR without METFE. TXQMAM stays until the TX space interrupt
+    uint16_t rxfdpr;                   //RXFDPR (the EMS bit can't be read back)
+    uint16_t multicastHash[4];         //Multicast hash table (MAHTR0-3), written again after a reset
+    bool allMulticast;                 //All multicast frames are received (RXCR1_RXMAFMA)
+    //RX polling (see NetInterface.rxPollBudget): The timer replies to pollPort, which signals the task of the ISR
+    struct MsgPort pollPort;           //Reply port of the poll timer
+    struct timerequest pollTimer;      //timer.device request (UNIT_MICROHZ)
+    bool pollTimerOpen;                //timer.device is open (otherwise no polling)
+    bool pollTimerRunning;             //pollTimer was sent and has not been received back yet
+    bool rxPolling;                    //Polling mode: IER_RXIE stays disabled, the timer reads the RXQ
 
  } Ksz8851Context;
 
@@ -474,20 +586,89 @@ uint16_t swap(uint16_t);
  void ksz8851DisableIrq(NetInterface *interface);
  bool_t ksz8851IrqHandler(register NetInterface *interface);
  bool ksz8851EventHandler(NetInterface *interface);
+ bool ksz8851EventHandlerInterrupt(NetInterface *interface);
  error_t ksz8851SendPacket(NetInterface *interface, uint8_t * buffer, size_t length);
+ error_t ksz8851SendPacketV(NetInterface *interface, const NetTxSegment * segments, uint16_t count);
+ uint16_t ksz8851SendPackets(NetInterface *interface, NetTxFrame * frames, uint16_t count);
  error_t ksz8851ReceivePacket(NetInterface *interface);
+ uint16_t ksz8851DrainRxQueue(NetInterface *interface, uint8_t frameCount);
  error_t ksz8851UpdateMacAddrFilter(NetInterface *interface);
+ #ifndef KSZ8851_FIXED_BIG_ENDIAN
  void ksz8851WriteReg(NetInterface *interface, uint8_t address, uint16_t data);
  uint16_t ksz8851ReadReg(NetInterface *interface, uint8_t address);
+ #endif
  uint8_t ksz8851ReadReg8(NetInterface * ks, uint8_t offset);
  void ksz8851WriteFifo(NetInterface *interface, const uint8_t *data, size_t length);
  uint16_t ksz8851WriteFifoWordAlign(register NetInterface *interface, register const uint8_t *data, register size_t lengthInBytes);
  void ksz8851ReadFifo(NetInterface *interface, uint8_t *data, size_t length);
+ void ksz8851ReadFifoBytes(NetInterface *interface, uint8_t *data, size_t length);
+ void ksz8851SkipFifo(NetInterface *interface, uint16_t sizeInWord);
  void ksz8851SetBit(NetInterface *interface, uint8_t address, uint16_t mask);
  void ksz8851ClearBit(NetInterface *interface, uint8_t address, uint16_t mask);
  uint32_t ksz8851CalcCrc(const void *data, size_t length);
+ uint8_t ksz8851MulticastHash(const MacAddr *address);
  void ksz8851DumpReg(NetInterface *interface);
  void ksz8851SoftReset(NetInterface *interface, uint8_t op);
- error_t ksz8851SetMulticastFilter(NetInterface *interface, MacFilterEntry filter[], uint8_t fileEntries);
+ uint16_t ksz8851DisableInterrupts(NetInterface *interface);
+ void ksz8851EnableInterrupts(NetInterface *interface, uint16_t enableMask);
+ error_t ksz8851SetMulticastFilter(NetInterface *interface, const MacFilterEntry filter[], uint8_t fileEntries);
+ void ksz8851SetRxCoalescing(NetInterface *interface);
+ void ksz8851SetChecksumOffload(NetInterface *interface);
+ void ksz8851AdaptRxCoalescing(NetInterface *interface, uint16_t rxqcr, uint8_t frameCount);
+ uint16_t ksz8851CheckShadowRegs(NetInterface *interface);
+
+ /**
+  * Shadow of a register (IER, RXQCR, TXQCR or RXFDPR, see Ksz8851Context)
+  */
+ static inline uint16_t * ksz8851ShadowReg(Ksz8851Context * context, uint8_t address)
+ {
+    switch (address) {
+       case KSZ8851_REG_IER:   return &context->ier;
+       case KSZ8851_REG_RXQCR: return &context->rxqcr;
+       case KSZ8851_REG_TXQCR: return &context->txqcr;
+       default:                return &context->rxfdpr;
+    }
+ }
+
+ /**
+  * Bits of a shadowed register that are written, but not kept in the shadow: "one shot" commands and
+  * status bits
+  */
+ static inline uint16_t ksz8851ShadowOneShotBits(uint8_t address)
+ {
+    switch (address) {
+       case KSZ8851_REG_RXQCR: return RXQCR_RRXEF | RXQCR_RXFCTS | RXQCR_RXDBCTS | RXQCR_RXDTTS;
+       case KSZ8851_REG_TXQCR: return TXQCR_METFE;
+       default:                return 0;
+    }
+ }
+
+ /**
+  * @brief Writes a shadowed register (IER, RXQCR, TXQCR or RXFDPR) and updates its shadow
+  * @param[in] interface Underlying network interface
+  * @param[in] address Register address
+  * @param[in] value Value to write (incl. "one shot" bits)
+  **/
+ static inline void ksz8851WriteShadowReg(NetInterface *interface, uint8_t address, uint16_t value)
+ {
+    *ksz8851ShadowReg((Ksz8851Context *)interface->nicContext, address) = value & ~ksz8851ShadowOneShotBits(address);
+    ksz8851WriteReg(interface, address, value);
+ }
+
+ /**
+  * @brief Sets bits of a shadowed register (a single write, unlike ksz8851SetBit)
+  **/
+ static inline void ksz8851SetShadowBit(NetInterface *interface, uint8_t address, uint16_t mask)
+ {
+    ksz8851WriteShadowReg(interface, address, *ksz8851ShadowReg((Ksz8851Context *)interface->nicContext, address) | mask);
+ }
+
+ /**
+  * @brief Clears bits of a shadowed register (a single write, unlike ksz8851ClearBit)
+  **/
+ static inline void ksz8851ClearShadowBit(NetInterface *interface, uint8_t address, uint16_t mask)
+ {
+    ksz8851WriteShadowReg(interface, address, *ksz8851ShadowReg((Ksz8851Context *)interface->nicContext, address) & ~mask);
+ }
 
  #endif
@@ -17,6 +17,7 @@
 #include <string.h>
 
 #include "ksz8851.h"
+#include "fifo.h"
 #include "types.h"
 
 int build_number = 1;
@@ -61,6 +62,8 @@ BOOL swappingCmdRegValue      = false;
 BOOL switchChipToBigEndian    = false;
 BOOL switchChipToLittleEndian = false;
 BOOL resetCmd = FALSE;
+BOOL fifoTest = FALSE;
+BOOL profile = FALSE;
 
 
 void printCCR(NetInterface* ks) {
@@ -80,7 +83,7 @@ void printCCR(NetInterface* ks) {
  * @param buffer
  * @param size
  */
-void processPacket(uint8_t * buffer, uint16_t size ) {
+void processPacket(NetInterface * interface, uint8_t * buffer, uint16_t size ) {
 
    MacAddr * dst = (MacAddr*)(buffer+0);
    MacAddr * src = (MacAddr*)(buffer+6);
@@ -179,9 +182,7 @@ void waitNICIsUp(NetInterface * interface) {
       Wait(0xffffffffl);
 
       //process all events
-      Disable();
       ksz8851EventHandler(interface);
-      Enable();
 
       Delay(10);
 
@@ -247,6 +248,168 @@ void sendPackets(NetInterface * interface, int countOfPackets) {
    printf("%d pkts sent out! (in %ld ticks => %ld bytes / s)\n", pktCount, diffTicks, bytesProSec );
 }
 
+/*
+ * FIFO kernel test: Reference implementations (the simple word loops) of the kernels in fifo.c
+ */
+static void referenceReadWords(uint16_t * data, uint16_t count) {
+   while (count--) {
+      *(data++) = KSZ8851_DATA_READ();
+   }
+}
+
+static void referenceReadWordsSwapped(uint16_t * data, uint16_t count) {
+   uint8_t * bytes = (uint8_t*)data;
+   while (count--) {
+      uint16_t value = KSZ8851_DATA_READ();
+      *(bytes++) = value & 0xFF;
+      *(bytes++) = (value >> 8) & 0xFF;
+   }
+}
+
+static void referenceWriteWords(const uint16_t * data, uint16_t count) {
+   while (count--) {
+      KSZ8851_DATA_WRITE(*(data++));
+   }
+}
+
+static void referenceWriteWordsSwapped(const uint16_t * data, uint16_t count) {
+   const uint8_t * bytes = (const uint8_t*)data;
+   while (count--) {
+      uint16_t value = *(bytes++);
+      value |= (*(bytes++)) << 8;
+      KSZ8851_DATA_WRITE(value);
+   }
+}
+
+static void referenceSkipWords(uint16_t count) {
+   volatile uint16_t dummy UNUSED;
+   while (count--) {
+      dummy = KSZ8851_DATA_READ();
+   }
+}
+
+//Not a multiple of the block size: the rest of the unrolled kernels is tested too
+#define FIFOTEST_WORDS  757
+#define FIFOTEST_ROUNDS 500
+#define FIFOTEST_FILL   0xdead
+
+/*
+ * Prints the throughput of a kernel and of the reference implementation.
+ */
+static void printFifoSpeed(const char * name, ULONG kernelTicks, ULONG referenceTicks, bool ok) {
+   double words = (double)FIFOTEST_WORDS * FIFOTEST_ROUNDS * 50.0;
+   printf("  %-20s %s  kernel: %7ld words/s  reference: %7ld words/s\n", name, ok ? "ok    " : "FAILED",
+         (LONG)(kernelTicks ? words / kernelTicks : 0), (LONG)(referenceTicks ? words / referenceTicks : 0));
+}
+
+/**
+ * Checks the FIFO transfer kernels of this build against the reference implementations and measures
+ * both. The data port is used with a register selected in the command register: reads return the chip
+ * ID every time, writes go to the multicast hash register MAHTR0 (restored afterwards).
+ * @param interface
+ * @return true if all kernels transfer the same data as the reference
+ */
+bool testFifoKernels(NetInterface * interface) {
+   static uint16_t reference[FIFOTEST_WORDS + 1];
+   static uint16_t result[FIFOTEST_WORDS + 1];
+   struct DateStamp start, end;
+   ULONG kernelTicks, referenceTicks;
+   uint16_t savedHash = ksz8851ReadReg(interface, KSZ8851_REG_MAHTR0);
+   uint16_t referenceValue;
+   bool ok, allOk = true;
+   int i, round;
+
+   TEST_ENTERED();
+   printf("\n  Kernels: %s\n", ksz8851FifoKernelName);
+
+   //Read kernels (same data, the word behind the buffer is untouched)
+   {
+      void (*kernels[2])(uint16_t *, uint16_t) = { ksz8851FifoReadWords, ksz8851FifoReadWordsSwapped };
+      void (*references[2])(uint16_t *, uint16_t) = { referenceReadWords, referenceReadWordsSwapped };
+      const char * names[2] = { "read", "read swapped" };
+      int k;
+      for (k = 0; k < 2; k++) {
+         for (i = 0; i <= FIFOTEST_WORDS; i++) {
+            reference[i] = result[i] = FIFOTEST_FILL;
+         }
+         ksz8851ReadReg(interface, KSZ8851_REG_CIDER);
+         references[k](reference, FIFOTEST_WORDS);
+         kernels[k](result, FIFOTEST_WORDS);
+         ok = memcmp(reference, result, sizeof(result)) == 0 && result[FIFOTEST_WORDS] == FIFOTEST_FILL;
+
+         DateStamp(&start);
+         for (round = 0; round < FIFOTEST_ROUNDS; round++) {
+            kernels[k](result, FIFOTEST_WORDS);
+         }
+         DateStamp(&end);
+         kernelTicks = ticksDiff(&start, &end);
+         DateStamp(&start);
+         for (round = 0; round < FIFOTEST_ROUNDS; round++) {
+            references[k](reference, FIFOTEST_WORDS);
+         }
+         DateStamp(&end);
+         referenceTicks = ticksDiff(&start, &end);
+         printFifoSpeed(names[k], kernelTicks, referenceTicks, ok);
+         allOk &= ok;
+      }
+   }
+
+   //Write kernels (the last written word is in the register)
+   {
+      void (*kernels[2])(const uint16_t *, uint16_t) = { ksz8851FifoWriteWords, ksz8851FifoWriteWordsSwapped };
+      void (*references[2])(const uint16_t *, uint16_t) = { referenceWriteWords, referenceWriteWordsSwapped };
+      const char * names[2] = { "write", "write swapped" };
+      int k;
+      for (i = 0; i < FIFOTEST_WORDS; i++) {
+         reference[i] = 0x0102 * i;
+      }
+      for (k = 0; k < 2; k++) {
+         ksz8851WriteReg(interface, KSZ8851_REG_MAHTR0, savedHash);
+         references[k](reference, FIFOTEST_WORDS);
+         referenceValue = ksz8851ReadReg(interface, KSZ8851_REG_MAHTR0);
+         ksz8851WriteReg(interface, KSZ8851_REG_MAHTR0, savedHash);
+         kernels[k](reference, FIFOTEST_WORDS);
+         ok = ksz8851ReadReg(interface, KSZ8851_REG_MAHTR0) == referenceValue;
+
+         ksz8851WriteReg(interface, KSZ8851_REG_MAHTR0, savedHash);
+         DateStamp(&start);
+         for (round = 0; round < FIFOTEST_ROUNDS; round++) {
+            kernels[k](reference, FIFOTEST_WORDS);
+         }
+         DateStamp(&end);
+         kernelTicks = ticksDiff(&start, &end);
+         DateStamp(&start);
+         for (round = 0; round < FIFOTEST_ROUNDS; round++) {
+            references[k](reference, FIFOTEST_WORDS);
+         }
+         DateStamp(&end);
+         referenceTicks = ticksDiff(&start, &end);
+         printFifoSpeed(names[k], kernelTicks, referenceTicks, ok);
+         allOk &= ok;
+      }
+      ksz8851WriteReg(interface, KSZ8851_REG_MAHTR0, savedHash);
+   }
+
+   //Skip kernel (only the speed)
+   ksz8851ReadReg(interface, KSZ8851_REG_CIDER);
+   DateStamp(&start);
+   for (round = 0; round < FIFOTEST_ROUNDS; round++) {
+      ksz8851FifoSkipWords(FIFOTEST_WORDS);
+   }
+   DateStamp(&end);
+   kernelTicks = ticksDiff(&start, &end);
+   DateStamp(&start);
+   for (round = 0; round < FIFOTEST_ROUNDS; round++) {
+      referenceSkipWords(FIFOTEST_WORDS);
+   }
+   DateStamp(&end);
+   referenceTicks = ticksDiff(&start, &end);
+   printFifoSpeed("skip", kernelTicks, referenceTicks, true);
+
+   TEST_LEAVE(allOk);
+   return allOk;
+}
+
 /**
  * Change endianness mode of the NIC
  * @param bigEndian
@@ -258,7 +421,7 @@ void switchEndianessMode(bool bigEndian) {
    if (bigEndian) {
       value |= RXFDPR_EMS; //Bit 11 = 1   => BigEndian, Bit can't read back!
    }
-   ksz8851WriteReg(interface, KSZ8851_REG_RXFDPR, value);
+   ksz8851WriteShadowReg(interface, KSZ8851_REG_RXFDPR, value);
    //Change mode so that all functions still can talk to the chip!
    context->isInBigEndianMode = bigEndian;
 }
@@ -323,6 +486,14 @@ int main(int argc, char * argv[])
             swappingCmdRegValue = true;
          }
 
+         if (strcmp(argv[i], "fifotest") == 0) {
+            fifoTest = true;
+         }
+
+         if (strcmp(argv[i], "profile") == 0) {
+            profile = true;
+         }
+
          if (strcmp(argv[i], "reset") == 0) {
                      resetCmd = true;
                   }
@@ -357,6 +528,8 @@ int main(int argc, char * argv[])
                   " swapcmd:  swap every 16 bit of cmd register value\n"
                   " send x:  send small packets\n"
                   " setmulticast: sets the multicast address 239.12.255.254\n"
+                  " fifotest: checks and measures the FIFO transfer kernels of this build\n"
+                  " profile: prints the register accesses per operation at exit (build with PROFILE=1)\n"
                   , argv[0]);
             exit(0);
          }
@@ -389,6 +562,10 @@ int main(int argc, char * argv[])
             exit(0);
          }
 
+         if (fifoTest) {
+            exit(testFifoKernels(interface) ? 0 : 10);
+         }
+
          //Set chip to big endian?
          if (switchChipToBigEndian){
             switchEndianessMode(true);
@@ -419,16 +596,14 @@ int main(int argc, char * argv[])
             //Wait for any signal:
             ULONG receivedSignalMask = Wait(0xffffffff);
             printf("Signal: signal=#%ld, overrun=#%ld\n",
-                  context->signalCounter, context->rxOverrun);
+                  context->signalCounter, interface->rxOverruns);
 
             //Stop if ctrl-c
             if (receivedSignalMask & SIGBREAKF_CTRL_C)
                break;
 
             //Process event on event handler...
-            Disable();
             interface->processEvents(interface);
-            Enable();
 
             //Print some MIBs
             //printMIB(ks);
@@ -457,6 +632,9 @@ void traceout(char * format, ...) {
  * Exit handler. Dump register.
  */
 void done(void) {
+   if (profile) {
+      ksz8851ProfileDump(traceout);
+   }
    interface->deinit(interface);
    interface = NULL;
 }
@@ -0,0 +1,71 @@
+/*
+ * KSZ8851 Amiga Network Driver. This file contains the register access profiler (see profile.h).
+ */
+
+#include "profile.h"
+
+#include <string.h>
+#include <exec/types.h>
+
+#ifdef KSZ8851_PROFILE
+
+Ksz8851Profile ksz8851Profile;
+
+static const char * const opNames[KSZ8851_OP_COUNT] = {
+   "other", "reset", "receive", "send", "isr", "event"
+};
+
+static ULONG accesses(const Ksz8851ProfileCounters * counters)
+{
+   return counters->cmdWrites + counters->dataReads + counters->dataWrites;
+}
+
+/**
+ * Prints "value / divisor" with one decimal place (no floating point in the driver). The arguments are passed
+ * as long: ULONG is only 32 bit on the host build.
+ */
+static void printRatio(Ksz8851ProfilePrint print, ULONG value, ULONG divisor)
+{
+   ULONG tenths = divisor ? (value * 10 + divisor / 2) / divisor : 0;
+   print(" %6ld.%ld", (long)(tenths / 10), (long)(tenths % 10));
+}
+
+#endif
+
+void ksz8851ProfileReset(void)
+{
+#ifdef KSZ8851_PROFILE
+   uint8_t op = ksz8851Profile.op;
+   memset(&ksz8851Profile, 0, sizeof(ksz8851Profile));
+   ksz8851Profile.op = op;
+#endif
+}
+
+void ksz8851ProfileDump(Ksz8851ProfilePrint print)
+{
+#ifdef KSZ8851_PROFILE
+   const Ksz8851ProfileCounters * ops = ksz8851Profile.ops;
+   ULONG handler = accesses(&ops[KSZ8851_OP_ISR]) + accesses(&ops[KSZ8851_OP_EVENT]);
+   ULONG frames  = ops[KSZ8851_OP_RECEIVE].frames + ops[KSZ8851_OP_SEND].frames;
+   uint16_t i;
+
+   print("Register accesses:\n%-8s %8s %8s %8s %8s %8s %8s %8s\n", "op", "calls", "frames", "cmd", "read", "write",
+         "acc/call", "acc/frm");
+   for (i = 0; i < KSZ8851_OP_COUNT; i++) {
+      print("%-8s %8ld %8ld %8ld %8ld %8ld", opNames[i], (long)ops[i].calls, (long)ops[i].frames,
+            (long)ops[i].cmdWrites, (long)ops[i].dataReads, (long)ops[i].dataWrites);
+      printRatio(print, accesses(&ops[i]), ops[i].calls);
+      printRatio(print, accesses(&ops[i]), ops[i].frames);
+      print("\n");
+   }
+   print("Accesses per received frame:");
+   printRatio(print, accesses(&ops[KSZ8851_OP_RECEIVE]), ops[KSZ8851_OP_RECEIVE].frames);
+   print("\nAccesses per sent frame:    ");
+   printRatio(print, accesses(&ops[KSZ8851_OP_SEND]), ops[KSZ8851_OP_SEND].frames);
+   print("\nInterrupt + event handler accesses per frame:");
+   printRatio(print, handler, frames);
+   print("\n");
+#else
+   print("Register access profiler not built in (make PROFILE=1)\n");
+#endif
+}
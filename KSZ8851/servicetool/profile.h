@@ -0,0 +1,70 @@
+#ifndef _KSZ8851_PROFILE_H
+#define _KSZ8851_PROFILE_H
+
+#include <stdint.h>
+
+/*
+ * Register access profiler (make PROFILE=1, after a make clean): Every access to the command and data port
+ * (KSZ8851_CMD_WRITE, KSZ8851_DATA_READ, KSZ8851_DATA_WRITE and the FIFO kernels) is counted for the operation
+ * that is running at that moment. The ISR saves and restores the running operation, so the accesses of an
+ * interrupt are never counted for the interrupted task. Without KSZ8851_PROFILE all macros are empty.
+ */
+
+/**
+ * Operations the accesses are attributed to
+ */
+typedef enum {
+   KSZ8851_OP_OTHER,    //Everything else (online/offline, address filters, register dumps, service tool)
+   KSZ8851_OP_RESET,    //Init and reset of the chip
+   KSZ8851_OP_RECEIVE,  //Reading one frame from the RXQ (ksz8851ReceivePacket)
+   KSZ8851_OP_SEND,     //Writing a batch of frames into the TXQ (ksz8851SendPackets)
+   KSZ8851_OP_ISR,      //Interrupt handler (also for interrupts of other hardware on INT6)
+   KSZ8851_OP_EVENT,    //Event handler without the frames it receives
+   KSZ8851_OP_COUNT
+} Ksz8851ProfileOp;
+
+typedef struct {
+   uint32_t calls;       //Number of times the operation was started
+   uint32_t frames;      //Frames received or sent by the operation
+   uint32_t cmdWrites;   //Writes to the command register
+   uint32_t dataReads;   //Reads from the data register
+   uint32_t dataWrites;  //Writes to the data register
+} Ksz8851ProfileCounters;
+
+typedef struct {
+   volatile uint8_t op;  //Running operation (Ksz8851ProfileOp)
+   Ksz8851ProfileCounters ops[KSZ8851_OP_COUNT];
+} Ksz8851Profile;
+
+//Output function of ksz8851ProfileDump (like traceout)
+typedef void (*Ksz8851ProfilePrint)(char * format, ...);
+
+#ifdef KSZ8851_PROFILE
+   extern Ksz8851Profile ksz8851Profile;
+
+   //Counts "n" accesses or frames for the running operation
+   #define KSZ8851_PROFILE_COUNT(counter, n) (ksz8851Profile.ops[ksz8851Profile.op].counter += (n))
+   //Starts an operation (in the declarations of a function). Every return must be preceded by KSZ8851_PROFILE_LEAVE.
+   #define KSZ8851_PROFILE_ENTER(operation) \
+      uint8_t profileInterruptedOp = (ksz8851Profile.ops[(operation)].calls++, ksz8851Profile.op); \
+      ksz8851Profile.op = (operation)
+   #define KSZ8851_PROFILE_LEAVE() (ksz8851Profile.op = profileInterruptedOp)
+#else
+   #define KSZ8851_PROFILE_COUNT(counter, n) ((void)0)
+   #define KSZ8851_PROFILE_ENTER(operation)
+   #define KSZ8851_PROFILE_LEAVE() ((void)0)
+#endif
+
+/**
+ * Clears all counters
+ */
+void ksz8851ProfileReset(void);
+
+/**
+ * Prints the counters, the accesses per call and per frame of every operation and the accesses per received
+ * and sent frame (incl. the interrupt and event handler share).
+ * @param print output function
+ */
+void ksz8851ProfileDump(Ksz8851ProfilePrint print);
+
+#endif
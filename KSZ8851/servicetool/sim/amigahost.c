@@ -0,0 +1,389 @@
+/*
+ * KSZ8851 Amiga Network Driver - Host build.
+ *
+ * Implementation of the few exec functions the hardware near library needs, modelled on a single
+ * CPU Amiga with one task. See include/amigahost.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/amigahost.h"
+#include "ksz8851sim.h"
+
+//Interrupt servers in the chain of INT6 (the NIC is the only user here)
+#define MAX_INT_SERVERS 4
+//Pending software interrupts (Cause)
+#define MAX_SOFT_INTS 4
+//Running timer.device requests
+#define MAX_TIMER_REQUESTS 4
+
+static struct Task hostTask = {
+      .tc_Node.ln_Name = "ksz8851 host task",
+      .tc_SigAlloc     = 0x0000ffff //system signals
+};
+
+static struct Interrupt * intServers[MAX_INT_SERVERS];
+static struct Interrupt * softInts[MAX_SOFT_INTS];
+static struct timerequest * timerRequests[MAX_TIMER_REQUESTS];
+static uint64_t timerExpiry[MAX_TIMER_REQUESTS];
+static char timerDevice[] = TIMERNAME;
+static int  disableCounter = 0;
+static int  forbidCounter  = 0;
+static BOOL interruptLine  = FALSE;
+static BOOL inInterrupt    = FALSE;
+static BOOL inSoftInt      = FALSE;
+
+/**
+ * Calls the pending software interrupts (when no interrupt is running and interrupts are enabled, like
+ * exec does when leaving an interrupt).
+ */
+static void callSoftInts(void)
+{
+   int i;
+   BOOL called = TRUE;
+
+   //Software interrupts don't interrupt each other
+   if (inSoftInt) {
+      return;
+   }
+   inSoftInt = TRUE;
+   while (called) {
+      called = FALSE;
+      for (i = 0; i < MAX_SOFT_INTS; i++) {
+         struct Interrupt * softInt = softInts[i];
+         if (softInt) {
+            softInts[i] = NULL;
+            softInt->is_Node.ln_Type = NT_INTERRUPT;
+            ((void (*)(APTR))softInt->is_Code)(softInt->is_Data);
+            called = TRUE;
+         }
+      }
+   }
+   inSoftInt = FALSE;
+}
+
+/**
+ * Calls the interrupt server chain as long as the (level triggered) interrupt line is asserted.
+ */
+static void callInterruptServers(void)
+{
+   int i;
+   int rounds = 0;
+
+   if (inInterrupt) {
+      return;
+   }
+   inInterrupt = TRUE;
+   disableCounter++;
+   while (interruptLine) {
+      BOOL handled = FALSE;
+      for (i = 0; i < MAX_INT_SERVERS && !handled; i++) {
+         if (intServers[i]) {
+            handled = ((uint8_t (*)(APTR))intServers[i]->is_Code)(intServers[i]->is_Data) != 0;
+         }
+      }
+      //Line still asserted after the chain was called (nobody cleared it)?
+      if (++rounds > 16) {
+         ksz8851SimReportInterruptStorm();
+         break;
+      }
+   }
+   disableCounter--;
+   inInterrupt = FALSE;
+   if (disableCounter == 0) {
+      callSoftInts();
+   }
+}
+
+void Disable(void)
+{
+   if (disableCounter++ == 0) {
+      ksz8851SimInterruptsDisabled(TRUE);
+   }
+}
+
+void Enable(void)
+{
+   if (--disableCounter == 0) {
+      ksz8851SimInterruptsDisabled(FALSE);
+      //Pending interrupt?
+      if (interruptLine) {
+         callInterruptServers();
+      } else {
+         callSoftInts();
+      }
+   }
+}
+
+void Forbid(void)
+{
+   forbidCounter++;
+}
+
+void Permit(void)
+{
+   forbidCounter--;
+}
+
+APTR AllocVec(ULONG byteSize, ULONG requirements)
+{
+   return (requirements & MEMF_CLEAR) ? calloc(1, byteSize) : malloc(byteSize);
+}
+
+void FreeVec(APTR memoryBlock)
+{
+   free(memoryBlock);
+}
+
+struct Task * FindTask(CONST_STRPTR name)
+{
+   return &hostTask;
+}
+
+BYTE AllocSignal(LONG signalNum)
+{
+   BYTE i;
+   for (i = 16; i < 32; i++) {
+      if ((signalNum == -1 || signalNum == i) && !(hostTask.tc_SigAlloc & (1UL << i))) {
+         hostTask.tc_SigAlloc |= (1UL << i);
+         return i;
+      }
+   }
+   return -1;
+}
+
+void FreeSignal(LONG signalNum)
+{
+   if (signalNum >= 0) {
+      hostTask.tc_SigAlloc &= ~(1UL << signalNum);
+   }
+}
+
+void Signal(struct Task * task, ULONG signalSet)
+{
+   task->tc_SigRecvd |= signalSet;
+}
+
+void Cause(struct Interrupt * interrupt)
+{
+   int i;
+
+   //Already pending?
+   if (interrupt->is_Node.ln_Type == NT_SOFTINT) {
+      return;
+   }
+   for (i = 0; i < MAX_SOFT_INTS; i++) {
+      if (!softInts[i]) {
+         interrupt->is_Node.ln_Type = NT_SOFTINT;
+         softInts[i] = interrupt;
+         break;
+      }
+   }
+   if (!inInterrupt && disableCounter == 0) {
+      callSoftInts();
+   }
+}
+
+void AddIntServer(LONG intNumber, struct Interrupt * interrupt)
+{
+   int i;
+   for (i = 0; i < MAX_INT_SERVERS; i++) {
+      if (!intServers[i]) {
+         intServers[i] = interrupt;
+         break;
+      }
+   }
+   //Already pending?
+   if (interruptLine && disableCounter == 0) {
+      callInterruptServers();
+   }
+}
+
+void RemIntServer(LONG intNumber, struct Interrupt * interrupt)
+{
+   int i;
+   for (i = 0; i < MAX_INT_SERVERS; i++) {
+      if (intServers[i] == interrupt) {
+         intServers[i] = NULL;
+      }
+   }
+}
+
+void Delay(LONG ticks)
+{
+   //One tick is 1/50 second
+   ksz8851SimAdvanceTime(ticks * 20000);
+}
+
+void InitSemaphore(struct SignalSemaphore * semaphore)
+{
+   semaphore->ss_NestCount  = 0;
+   semaphore->ss_QueueCount = -1;
+}
+
+void ObtainSemaphore(struct SignalSemaphore * semaphore)
+{
+   semaphore->ss_QueueCount++;
+   semaphore->ss_NestCount++;
+}
+
+void ReleaseSemaphore(struct SignalSemaphore * semaphore)
+{
+   semaphore->ss_NestCount--;
+   semaphore->ss_QueueCount--;
+}
+
+void NewList(struct List * list)
+{
+   list->lh_Head     = (struct Node *)&list->lh_Tail;
+   list->lh_Tail     = NULL;
+   list->lh_TailPred = (struct Node *)&list->lh_Head;
+}
+
+/**
+ * Puts a message at the end of the port and signals the task of the port (PutMsg).
+ */
+static void putMsg(struct MsgPort * port, struct Message * message)
+{
+   struct Node * node = &message->mn_Node;
+
+   Disable();
+   node->ln_Succ = (struct Node *)&port->mp_MsgList.lh_Tail;
+   node->ln_Pred = port->mp_MsgList.lh_TailPred;
+   port->mp_MsgList.lh_TailPred->ln_Succ = node;
+   port->mp_MsgList.lh_TailPred = node;
+   Enable();
+   if (port->mp_Flags == PA_SIGNAL) {
+      Signal((struct Task *)port->mp_SigTask, 1UL << port->mp_SigBit);
+   }
+}
+
+/**
+ * Removes a node from its list (Remove).
+ */
+static void removeNode(struct Node * node)
+{
+   node->ln_Pred->ln_Succ = node->ln_Succ;
+   node->ln_Succ->ln_Pred = node->ln_Pred;
+   node->ln_Succ = node->ln_Pred = NULL;
+}
+
+struct Message * GetMsg(struct MsgPort * port)
+{
+   struct Node * node;
+
+   Disable();
+   node = port->mp_MsgList.lh_Head;
+   if (node->ln_Succ) {
+      removeNode(node);
+   } else {
+      node = NULL;
+   }
+   Enable();
+   return (struct Message *)node;
+}
+
+BYTE OpenDevice(CONST_STRPTR name, ULONG unit, struct IORequest * ioRequest, ULONG flags)
+{
+   if (strcmp(name, TIMERNAME) != 0 || unit != UNIT_MICROHZ) {
+      ioRequest->io_Error = -1;
+      return -1;
+   }
+   ioRequest->io_Device = timerDevice;
+   ioRequest->io_Error  = 0;
+   return 0;
+}
+
+void CloseDevice(struct IORequest * ioRequest)
+{
+   ioRequest->io_Device = NULL;
+}
+
+void SendIO(struct IORequest * ioRequest)
+{
+   struct timerequest * request = (struct timerequest *)ioRequest;
+   int i;
+
+   ioRequest->io_Message.mn_Node.ln_Type = NT_MESSAGE;
+   ioRequest->io_Error = 0;
+   for (i = 0; i < MAX_TIMER_REQUESTS; i++) {
+      if (!timerRequests[i]) {
+         timerRequests[i] = request;
+         timerExpiry[i]   = ksz8851SimGetTime() + (uint64_t)request->tr_time.tv_secs * 1000000000ULL +
+                            (uint64_t)request->tr_time.tv_micro * 1000;
+         return;
+      }
+   }
+   //No free slot: fails at once
+   ioRequest->io_Error = -1;
+   ioRequest->io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+   putMsg(ioRequest->io_Message.mn_ReplyPort, &ioRequest->io_Message);
+}
+
+/**
+ * Replies a running timer request (expired or aborted).
+ */
+static void replyTimerRequest(int i, BYTE error)
+{
+   struct IORequest * ioRequest = &timerRequests[i]->tr_node;
+
+   timerRequests[i] = NULL;
+   ioRequest->io_Error = error;
+   ioRequest->io_Message.mn_Node.ln_Type = NT_REPLYMSG;
+   putMsg(ioRequest->io_Message.mn_ReplyPort, &ioRequest->io_Message);
+}
+
+void AbortIO(struct IORequest * ioRequest)
+{
+   int i;
+   for (i = 0; i < MAX_TIMER_REQUESTS; i++) {
+      if (timerRequests[i] == (struct timerequest *)ioRequest) {
+         replyTimerRequest(i, IOERR_ABORTED);
+      }
+   }
+}
+
+BYTE WaitIO(struct IORequest * ioRequest)
+{
+   int i;
+
+   //Nobody else lets the time pass: a running request expires now
+   for (i = 0; i < MAX_TIMER_REQUESTS; i++) {
+      if (timerRequests[i] == (struct timerequest *)ioRequest) {
+         replyTimerRequest(i, 0);
+      }
+   }
+   //Remove the reply from the port
+   Disable();
+   if (ioRequest->io_Message.mn_Node.ln_Succ) {
+      removeNode(&ioRequest->io_Message.mn_Node);
+   }
+   Enable();
+   return ioRequest->io_Error;
+}
+
+void amigaHostTimePassed(uint64_t nowNs)
+{
+   int i;
+   for (i = 0; i < MAX_TIMER_REQUESTS; i++) {
+      if (timerRequests[i] && timerExpiry[i] <= nowNs) {
+         replyTimerRequest(i, 0);
+      }
+   }
+}
+
+ULONG amigaHostTakeSignals(void)
+{
+   ULONG signals = hostTask.tc_SigRecvd;
+   hostTask.tc_SigRecvd = 0;
+   return signals;
+}
+
+void amigaHostSetInterruptLine(BOOL asserted)
+{
+   interruptLine = asserted;
+   if (interruptLine && disableCounter == 0) {
+      callInterruptServers();
+   }
+}
@@ -0,0 +1,170 @@
+/*
+ * KSZ8851 Amiga Network Driver - Host build.
+ *
+ * Minimal replacement of the AmigaOS types and exec functions used by the hardware near
+ * library (ksz8851.c, isr.c). The functions are implemented in sim/amigahost.c and behave like
+ * on a single CPU Amiga: Disable() nests, interrupt servers are called when the simulated
+ * INT6 line is asserted and interrupts are not disabled.
+ */
+
+#ifndef _AMIGA_HOST_H
+#define _AMIGA_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t ULONG;
+typedef int32_t  LONG;
+typedef uint16_t UWORD;
+typedef int16_t  WORD;
+typedef uint8_t  UBYTE;
+typedef int8_t   BYTE;
+typedef int16_t  BOOL;
+typedef void *   APTR;
+typedef char *   STRPTR;
+typedef const char * CONST_STRPTR;
+
+#ifndef TRUE
+#define TRUE  1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define MEMF_ANY   0L
+#define MEMF_CLEAR (1L << 16)
+
+#define NT_INTERRUPT 2
+#define NT_MSGPORT   4
+#define NT_MESSAGE   5
+#define NT_REPLYMSG  7
+#define NT_SOFTINT   11
+
+//Message port actions
+#define PA_SIGNAL 0
+#define PA_IGNORE 2
+
+#define IOERR_ABORTED (-2)
+
+//timer.device
+#define TIMERNAME     "timer.device"
+#define UNIT_MICROHZ  0
+#define TR_ADDREQUEST 9
+
+//Interrupt number of the "external" interrupt (INT6)
+#define INTB_EXTER 13
+
+//Register arguments don't exist on the host
+#define REG(reg,arg) arg
+
+struct Node {
+   struct Node * ln_Succ;
+   struct Node * ln_Pred;
+   UBYTE  ln_Type;
+   BYTE   ln_Pri;
+   char * ln_Name;
+};
+
+struct List {
+   struct Node * lh_Head;
+   struct Node * lh_Tail;
+   struct Node * lh_TailPred;
+   UBYTE  lh_Type;
+   UBYTE  l_pad;
+};
+
+struct MsgPort {
+   struct Node mp_Node;
+   UBYTE  mp_Flags;
+   UBYTE  mp_SigBit;
+   APTR   mp_SigTask;
+   struct List mp_MsgList;
+};
+
+struct Message {
+   struct Node mn_Node;
+   struct MsgPort * mn_ReplyPort;
+   UWORD  mn_Length;
+};
+
+struct IORequest {
+   struct Message io_Message;
+   APTR   io_Device;
+   APTR   io_Unit;
+   UWORD  io_Command;
+   UBYTE  io_Flags;
+   BYTE   io_Error;
+};
+
+//The host headers have their own struct timeval (the NDK one has tv_secs and tv_micro)
+struct timerequest {
+   struct IORequest tr_node;
+   struct {
+      ULONG tv_secs;
+      ULONG tv_micro;
+   } tr_time;
+};
+
+struct Interrupt {
+   struct Node is_Node;
+   APTR   is_Data;
+   void   (*is_Code)(void);
+};
+
+struct Task {
+   struct Node tc_Node;
+   ULONG  tc_SigAlloc;
+   ULONG  tc_SigRecvd;
+};
+
+//Only one task on the host: a semaphore just nests
+struct SignalSemaphore {
+   WORD   ss_NestCount;
+   WORD   ss_QueueCount;   //-1: free
+};
+
+void   Disable(void);
+void   Enable(void);
+void   Forbid(void);
+void   Permit(void);
+APTR   AllocVec(ULONG byteSize, ULONG requirements);
+void   FreeVec(APTR memoryBlock);
+struct Task * FindTask(CONST_STRPTR name);
+BYTE   AllocSignal(LONG signalNum);
+void   FreeSignal(LONG signalNum);
+void   Signal(struct Task * task, ULONG signalSet);
+void   Cause(struct Interrupt * interrupt);
+void   AddIntServer(LONG intNumber, struct Interrupt * interrupt);
+void   RemIntServer(LONG intNumber, struct Interrupt * interrupt);
+void   Delay(LONG ticks);
+void   InitSemaphore(struct SignalSemaphore * semaphore);
+void   ObtainSemaphore(struct SignalSemaphore * semaphore);
+void   ReleaseSemaphore(struct SignalSemaphore * semaphore);
+void   NewList(struct List * list);
+struct Message * GetMsg(struct MsgPort * port);
+BYTE   OpenDevice(CONST_STRPTR name, ULONG unit, struct IORequest * ioRequest, ULONG flags);
+void   CloseDevice(struct IORequest * ioRequest);
+void   SendIO(struct IORequest * ioRequest);
+void   AbortIO(struct IORequest * ioRequest);
+BYTE   WaitIO(struct IORequest * ioRequest);
+
+/**
+ * Host only: Returns and clears the signals received by the (only) task.
+ */
+ULONG amigaHostTakeSignals(void);
+
+/**
+ * Host only: The simulated INT6 line has changed. Calls the interrupt servers when the line is
+ * asserted and interrupts are not disabled (otherwise when Enable() is called the last time).
+ * @param asserted
+ */
+void amigaHostSetInterruptLine(BOOL asserted);
+
+/**
+ * Host only: The simulated time has advanced (called by the chip simulator). Replies the timer.device
+ * requests that have expired (TR_ADDREQUEST of UNIT_MICROHZ, the only one supported).
+ * @param nowNs simulated time in nanoseconds
+ */
+void amigaHostTimePassed(uint64_t nowNs);
+
+#endif
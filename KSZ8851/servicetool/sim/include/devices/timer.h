@@ -0,0 +1,5 @@
+/*
+ * Host build of the KSZ8851 library: AmigaOS include replacement (see amigahost.h)
+ */
+
+#include "amigahost.h"
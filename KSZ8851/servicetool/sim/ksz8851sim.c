@@ -0,0 +1,784 @@
+/*
+ * KSZ8851 Amiga Network Driver - Host side chip simulator.
+ *
+ * See ksz8851sim.h. The model follows the behaviour the driver relies on:
+ *  - The data port accesses a register when it directly follows a write to the command register.
+ *    Otherwise (and RXQCR_SDA is set) it accesses the QMU: reads come from the current RX frame,
+ *    writes go into the TXQ.
+ *  - The QMU is a byte stream. In big endian mode (RXFDPR_EMS) the first byte of a word is the
+ *    one at the lower address of the host, in little endian mode it is the low byte of the word.
+ *  - An RX frame is read as: dummy word, status word, byte count word, [2 pad bytes], frame, CRC,
+ *    padded to a DWORD boundary. The byte count contains the CRC and the pad bytes.
+ */
+
+#include <string.h>
+
+#include "include/amigahost.h"
+#include "ksz8851sim.h"
+#include "../ksz8851.h"
+
+#define ALIGN4(x)             (((x) + 3) & ~3)
+#define SIM_REG(address)      regs[(address) >> 1]
+
+//Maximal frames in RXQ (RXFCTR counts 8 bits only)
+#define SIM_RXQ_FRAMES        255
+#define SIM_MAX_FRAME         2000
+#define SIM_TXQ_FRAMES        64
+
+typedef struct {
+   uint8_t  data[SIM_MAX_FRAME];
+   uint16_t length;                 //Length of the frame (without CRC)
+   uint16_t status;                 //Frame status (RXFHSR and frame header)
+} SimFrame;
+
+typedef struct {
+   uint8_t  data[SIM_MAX_FRAME + 8];
+   uint16_t length;                 //Bytes to transmit (from TX header)
+   uint16_t control;                //Control word (from TX header)
+   bool     enqueued;               //Enqueued for transmission (METFE/AETFE)
+} SimTxFrame;
+
+static uint16_t regs[128];
+static uint8_t  cmdAddress;          //Register selected by the last command
+static uint16_t cmdLaneMask;         //Bytes selected by the last command (0xff00, 0x00ff)
+static bool     cmdArmed;            //Next data access is a register access
+static bool     bigEndian;
+
+//RXQ
+static SimFrame rxq[SIM_RXQ_FRAMES];
+static uint16_t rxHead;
+static uint16_t rxCount;
+static uint32_t rxBytesUsed;
+static uint16_t rxPointer;           //Read position in the current frame (byte stream)
+static bool     rxAccessed;          //Current frame was read during the SDA phase
+static uint64_t rxTimerStartNs;      //Arrival of the oldest frame not signalled yet
+static bool     rxTimerRunning;      //There are frames not signalled yet
+
+//TXQ
+static SimTxFrame txq[SIM_TXQ_FRAMES];
+static uint16_t txCount;
+static uint32_t txBytesUsed;
+static uint8_t  txStage[SIM_MAX_FRAME + 8]; //Frame written in the current SDA phase
+static uint16_t txStageLength;
+
+static Ksz8851SimWireFunction wireFunction;
+static void *   wireUserData;
+static bool     wireAutoTransmit = true;
+
+//Bus timing and statistics
+static uint16_t cmdWriteCost  = 8;
+static uint16_t dataReadCost  = 8;
+static uint16_t dataWriteCost = 8;
+static uint32_t cpuHz = 14000000;
+static uint64_t timeNs;
+static bool     interruptLine;
+static uint32_t disabledSinceCycles;
+static Ksz8851SimCounters counters;
+
+static void rxCheckThresholds(void);
+static void updateInterruptLine(void);
+
+/**
+ * Time passes with every bus access
+ */
+static void busAccess(uint16_t cycles)
+{
+   counters.busCycles += cycles;
+   timeNs += ((uint64_t)cycles * 1000000000ULL) / cpuHz;
+}
+
+static uint16_t rxFootprint(uint16_t length)
+{
+   //Frame with CRC plus status and byte count
+   return ALIGN4(length + 4) + 4;
+}
+
+static uint16_t txFootprint(uint16_t length)
+{
+   return ALIGN4(length) + 4;
+}
+
+static uint16_t rxByteCount(const SimFrame * frame)
+{
+   return frame->length + 4 + ((SIM_REG(KSZ8851_REG_RXQCR) & RXQCR_RXIPHTOE) ? 2 : 0);
+}
+
+/**
+ * Byte at "position" of the byte stream of the current RX frame
+ */
+static uint8_t rxStreamByte(uint16_t position)
+{
+   const SimFrame * frame = &rxq[rxHead];
+   uint16_t byteCount = rxByteCount(frame);
+   uint16_t pad = (SIM_REG(KSZ8851_REG_RXQCR) & RXQCR_RXIPHTOE) ? 2 : 0;
+
+   switch (position) {
+      case 0: case 1:
+         return 0; //dummy
+      case 2:
+         return (uint8_t)frame->status;
+      case 3:
+         return (uint8_t)(frame->status >> 8);
+      case 4:
+         return (uint8_t)byteCount;
+      case 5:
+         return (uint8_t)(byteCount >> 8);
+      default:
+         position -= 6;
+         if (position < pad) {
+            return 0;
+         }
+         position -= pad;
+         if (position < frame->length) {
+            return frame->data[position];
+         }
+         //CRC (not calculated) and DWORD padding
+         return 0;
+   }
+}
+
+static void rxReleaseFrame(void)
+{
+   if (rxCount > 0) {
+      rxBytesUsed -= rxFootprint(rxq[rxHead].length);
+      rxHead = (rxHead + 1) % SIM_RXQ_FRAMES;
+      rxCount--;
+   }
+   if (rxCount == 0) {
+      rxTimerRunning = false;
+   }
+   rxPointer = 0;
+   rxAccessed = false;
+}
+
+/**
+ * Hash of the chip (datasheet): MSB first CRC-32 over the address bits in wire order, bit by bit. The driver
+ * uses a table driven CRC (ksz8851MulticastHash), this one is the reference.
+ */
+static uint32_t simMulticastCrc(const uint8_t * address)
+{
+   uint32_t crc = 0xFFFFFFFF;
+   uint8_t i, j;
+
+   for (i = 0; i < 6; i++) {
+      for (j = 0; j < 8; j++) {
+         if (((crc >> 31) ^ (address[i] >> j)) & 0x01) {
+            crc = (crc << 1) ^ 0x04C11DB7;
+         } else {
+            crc = crc << 1;
+         }
+      }
+   }
+   return crc;
+}
+
+static bool macMatchesHashTable(const uint8_t * address)
+{
+   uint32_t crc = simMulticastCrc(address);
+   uint8_t k = (crc >> 26) & 0x3F;
+   return (SIM_REG(KSZ8851_REG_MAHTR0 + (k / 16) * 2) & (1 << (k % 16))) != 0;
+}
+
+/**
+ * Ones' complement sum of 16 bit big endian words
+ */
+static uint32_t checksumAdd(const uint8_t * data, uint16_t length, uint32_t sum)
+{
+   for (; length > 1; data += 2, length -= 2) {
+      sum += data[0] << 8 | data[1];
+   }
+   if (length) {
+      sum += data[0] << 8;
+   }
+   return sum;
+}
+
+static uint16_t checksumFold(uint32_t sum)
+{
+   while (sum >> 16) {
+      sum = (sum & 0xffff) + (sum >> 16);
+   }
+   return (uint16_t)~sum;
+}
+
+/**
+ * Checksum offload of the chip (IPv4 only, L4 checksums not for fragments). Fills in or checks the checksums of
+ * the protocols in "protocols" (RXFHSR_RXIPFCS, RXFHSR_RXTCPFCS, RXFHSR_RXUDPFCS, RXFHSR_RXICMPFCS).
+ * @return the protocols with a wrong checksum (check only)
+ */
+static uint16_t ipChecksums(uint8_t * frame, uint16_t length, uint16_t protocols, bool fill)
+{
+   uint8_t * ip = frame + 14;
+   uint8_t * l4;
+   uint16_t headerLength, totalLength, l4Length, checksumOffset, protocol, checksum;
+   uint32_t sum = 0;
+   uint16_t errors = 0;
+
+   if (length < 34 || frame[12] != 0x08 || frame[13] != 0x00 || (ip[0] >> 4) != 4) {
+      return 0;
+   }
+   headerLength = (ip[0] & 0x0f) * 4;
+   totalLength  = ip[2] << 8 | ip[3];
+   if (headerLength < 20 || totalLength < headerLength || 14 + totalLength > length) {
+      return 0;
+   }
+
+   if (protocols & RXFHSR_RXIPFCS) {
+      if (fill) {
+         ip[10] = ip[11] = 0;
+         checksum = checksumFold(checksumAdd(ip, headerLength, 0));
+         ip[10] = checksum >> 8;
+         ip[11] = checksum;
+      } else if (checksumFold(checksumAdd(ip, headerLength, 0)) != 0) {
+         errors |= RXFHSR_RXIPFCS;
+      }
+   }
+
+   //Fragment (more fragments or offset)?
+   if ((ip[6] & 0x3f) || ip[7]) {
+      return errors;
+   }
+   l4       = ip + headerLength;
+   l4Length = totalLength - headerLength;
+   switch (ip[9]) {
+      case 1:  protocol = RXFHSR_RXICMPFCS; checksumOffset = 2;  break;
+      case 6:  protocol = RXFHSR_RXTCPFCS;  checksumOffset = 16; break;
+      case 17: protocol = RXFHSR_RXUDPFCS;  checksumOffset = 6;  break;
+      default: return errors;
+   }
+   if (!(protocols & protocol) || l4Length < checksumOffset + 2) {
+      return errors;
+   }
+   //Pseudo header (not for ICMP): addresses, protocol, length
+   if (protocol != RXFHSR_RXICMPFCS) {
+      sum = checksumAdd(ip + 12, 8, ip[9] + l4Length);
+   }
+   if (fill) {
+      l4[checksumOffset] = l4[checksumOffset + 1] = 0;
+      checksum = checksumFold(checksumAdd(l4, l4Length, sum));
+      //UDP: 0 means no checksum
+      if (checksum == 0 && protocol == RXFHSR_RXUDPFCS) {
+         checksum = 0xffff;
+      }
+      l4[checksumOffset]     = checksum >> 8;
+      l4[checksumOffset + 1] = checksum;
+   } else if (protocol == RXFHSR_RXUDPFCS && l4[6] == 0 && l4[7] == 0) {
+      //No UDP checksum (passes with RXCR2_RXIUFCEZ)
+   } else if (checksumFold(checksumAdd(l4, l4Length, sum)) != 0) {
+      errors |= protocol;
+   }
+   return errors;
+}
+
+void ksz8851SimFillChecksums(uint8_t * frame, uint16_t length)
+{
+   ipChecksums(frame, length, RXFHSR_RXIPFCS | RXFHSR_RXTCPFCS | RXFHSR_RXUDPFCS | RXFHSR_RXICMPFCS, true);
+}
+
+/**
+ * Protocols the receiver checks (RXCR1, RXCR2)
+ */
+static uint16_t rxChecksumProtocols(void)
+{
+   uint16_t rxcr1 = SIM_REG(KSZ8851_REG_RXCR1);
+   return ((rxcr1 & RXCR1_RXIPFCC)  ? RXFHSR_RXIPFCS  : 0) |
+          ((rxcr1 & RXCR1_RXTCPFCC) ? RXFHSR_RXTCPFCS : 0) |
+          ((rxcr1 & RXCR1_RXUDPFCC) ? RXFHSR_RXUDPFCS : 0) |
+          ((SIM_REG(KSZ8851_REG_RXCR2) & RXCR2_RXICMPFCC) ? RXFHSR_RXICMPFCS : 0);
+}
+
+/**
+ * Protocols the transmitter fills in (TXCR)
+ */
+static uint16_t txChecksumProtocols(void)
+{
+   uint16_t txcr = SIM_REG(KSZ8851_REG_TXCR);
+   return ((txcr & TXCR_TCGIP)   ? RXFHSR_RXIPFCS  : 0) |
+          ((txcr & TXCR_TCGTCP)  ? RXFHSR_RXTCPFCS : 0) |
+          ((txcr & TXCR_TCGUDP)  ? RXFHSR_RXUDPFCS : 0) |
+          ((txcr & TXCR_TCGICMP) ? RXFHSR_RXICMPFCS : 0);
+}
+
+/**
+ * Address filter of the receiver (RXCR1)
+ */
+static bool rxAcceptFrame(const uint8_t * frame)
+{
+   uint16_t rxcr1 = SIM_REG(KSZ8851_REG_RXCR1);
+   static const uint8_t broadcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+   if (!(rxcr1 & RXCR1_RXE)) {
+      return false;
+   }
+   if (rxcr1 & RXCR1_RXAE) {
+      return true;
+   }
+   if (memcmp(frame, broadcast, 6) == 0) {
+      return (rxcr1 & RXCR1_RXBE) != 0;
+   }
+   if (frame[0] & 0x01) {
+      return (rxcr1 & RXCR1_RXMAFMA) || ((rxcr1 & RXCR1_RXME) && macMatchesHashTable(frame));
+   }
+   return (rxcr1 & RXCR1_RXUE) &&
+          (frame[0] << 8 | frame[1]) == SIM_REG(KSZ8851_REG_MARH) &&
+          (frame[2] << 8 | frame[3]) == SIM_REG(KSZ8851_REG_MARM) &&
+          (frame[4] << 8 | frame[5]) == SIM_REG(KSZ8851_REG_MARL);
+}
+
+/**
+ * Sets RXIS if one of the enabled thresholds is reached (every frame if no threshold is enabled)
+ */
+static void rxCheckThresholds(void)
+{
+   uint16_t rxqcr = SIM_REG(KSZ8851_REG_RXQCR);
+   uint16_t status = 0;
+
+   if (rxCount == 0 || !rxTimerRunning) {
+      return;
+   }
+   if (!(rxqcr & (RXQCR_RXFCTE | RXQCR_RXDBCTE | RXQCR_RXDTTE))) {
+      status = RXQCR_RXFCTS;
+   }
+   if ((rxqcr & RXQCR_RXFCTE) && rxCount >= (SIM_REG(KSZ8851_REG_RXFCTR) & 0xff)) {
+      status |= RXQCR_RXFCTS;
+   }
+   if ((rxqcr & RXQCR_RXDBCTE) && rxBytesUsed >= SIM_REG(KSZ8851_REG_RXDBCTR)) {
+      status |= RXQCR_RXDBCTS;
+   }
+   if ((rxqcr & RXQCR_RXDTTE) && (timeNs - rxTimerStartNs) >= (uint64_t)SIM_REG(KSZ8851_REG_RXDTTR) * 1000) {
+      status |= RXQCR_RXDTTS;
+   }
+   if (status) {
+      SIM_REG(KSZ8851_REG_RXQCR) |= status;
+      SIM_REG(KSZ8851_REG_ISR) |= ISR_RXIS;
+      rxTimerRunning = false;
+      updateInterruptLine();
+   }
+}
+
+static void txCheckSpaceAvailable(void)
+{
+   if ((SIM_REG(KSZ8851_REG_TXQCR) & TXQCR_TXQMAM) &&
+       (KSZ8851_SIM_TXQ_SIZE - txBytesUsed) >= (SIM_REG(KSZ8851_REG_TXNTFSR) & TXMIR_TXMA_MASK)) {
+      SIM_REG(KSZ8851_REG_TXQCR) &= ~TXQCR_TXQMAM;
+      SIM_REG(KSZ8851_REG_ISR) |= ISR_TXSAIS;
+      updateInterruptLine();
+   }
+}
+
+/**
+ * A frame is completely written into the TXQ (TX header + data)
+ */
+static void txCommitStage(void)
+{
+   uint16_t control = txStage[0] | (txStage[1] << 8);
+   uint16_t length  = (txStage[2] | (txStage[3] << 8)) & 0x7ff;
+
+   if (txCount < SIM_TXQ_FRAMES && txBytesUsed + txFootprint(length) <= KSZ8851_SIM_TXQ_SIZE) {
+      SimTxFrame * frame = &txq[txCount++];
+      memcpy(frame->data, txStage + 4, length);
+      frame->length   = length;
+      frame->control  = control;
+      frame->enqueued = false;
+      txBytesUsed += txFootprint(length);
+   } else {
+      //Host wrote more than TXMIR allowed, frame is lost
+      counters.framesDropped++;
+   }
+   txStageLength = 0;
+}
+
+static void txEnqueueFrames(void)
+{
+   uint16_t i;
+   for (i = 0; i < txCount; i++) {
+      txq[i].enqueued = true;
+   }
+   if (wireAutoTransmit) {
+      ksz8851SimTransmit(SIM_TXQ_FRAMES);
+   }
+}
+
+static void txWriteStream(uint8_t b0, uint8_t b1)
+{
+   if (txStageLength + 2 <= sizeof(txStage)) {
+      txStage[txStageLength++] = b0;
+      txStage[txStageLength++] = b1;
+   }
+   //TX header complete and the frame data (DWORD aligned) too?
+   if (txStageLength >= 4) {
+      uint16_t length = (txStage[2] | (txStage[3] << 8)) & 0x7ff;
+      if (txStageLength >= 4 + ALIGN4(length)) {
+         txCommitStage();
+      }
+   }
+}
+
+static void writeRxqcr(uint16_t value)
+{
+   uint16_t old = SIM_REG(KSZ8851_REG_RXQCR);
+
+   //Status bits are read only
+   value = (value & ~(RXQCR_RXDTTS | RXQCR_RXDBCTS | RXQCR_RXFCTS)) |
+           (old & (RXQCR_RXDTTS | RXQCR_RXDBCTS | RXQCR_RXFCTS));
+
+   if ((old & RXQCR_SDA) && !(value & RXQCR_SDA)) {
+      //End of a DMA phase: Auto dequeue of the read RX frame, queue the written TX frames
+      if (rxAccessed && (value & RXQCR_ADRFE)) {
+         rxReleaseFrame();
+      }
+      if (txStageLength) {
+         //Frame was not written completely
+         counters.framesDropped++;
+         txStageLength = 0;
+      }
+      if (SIM_REG(KSZ8851_REG_TXQCR) & TXQCR_AETFE) {
+         txEnqueueFrames();
+      }
+   }
+   if (!(old & RXQCR_SDA) && (value & RXQCR_SDA)) {
+      rxAccessed = false;
+      txStageLength = 0;
+   }
+   if (value & RXQCR_RRXEF) {
+      //Release the current frame (self clearing)
+      rxReleaseFrame();
+      value &= ~RXQCR_RRXEF;
+   }
+   SIM_REG(KSZ8851_REG_RXQCR) = value;
+}
+
+static void resetQueues(void)
+{
+   rxHead = rxCount = 0;
+   rxBytesUsed = 0;
+   rxPointer = 0;
+   rxAccessed = false;
+   rxTimerRunning = false;
+   txCount = 0;
+   txBytesUsed = 0;
+   txStageLength = 0;
+}
+
+static void resetRegisters(void)
+{
+   memset(regs, 0, sizeof(regs));
+   SIM_REG(KSZ8851_REG_CIDER)  = KSZ8851_REV_A3_ID;
+   SIM_REG(KSZ8851_REG_RXFCTR) = 0;
+   SIM_REG(KSZ8851_REG_P1SR)   = P1SR_LINK_GOOD | P1SR_OPERATION_SPEED | P1SR_OPERATION_DUPLEX;
+   bigEndian = false;
+   cmdArmed  = false;
+   resetQueues();
+}
+
+static uint16_t readRegister(uint8_t address)
+{
+   switch (address) {
+      case KSZ8851_REG_CCR:
+         return CCR_16_BIT_DATA_BUS | CCR_48_PIN_PACKAGE | (bigEndian ? 0 : CCR_BUS_ENDIAN_MODE);
+      case KSZ8851_REG_RXFHSR:
+         return rxCount ? rxq[rxHead].status : 0;
+      case KSZ8851_REG_RXFHBCR:
+         return rxCount ? rxByteCount(&rxq[rxHead]) : 0;
+      case KSZ8851_REG_RXFCTR:
+         return ((rxCount > 255 ? 255 : rxCount) << 8) | (SIM_REG(KSZ8851_REG_RXFCTR) & 0xff);
+      case KSZ8851_REG_TXMIR:
+         return (KSZ8851_SIM_TXQ_SIZE - txBytesUsed) & TXMIR_TXMA_MASK;
+      case KSZ8851_REG_RXFDPR:
+         //The endian mode can't be read back
+         return SIM_REG(KSZ8851_REG_RXFDPR) & ~RXFDPR_EMS;
+      default:
+         return SIM_REG(address);
+   }
+}
+
+static void writeRegister(uint8_t address, uint16_t value)
+{
+   switch (address) {
+      case KSZ8851_REG_ISR:
+         //Write 1 to clear
+         SIM_REG(KSZ8851_REG_ISR) &= ~value;
+         if (value & ISR_RXIS) {
+            SIM_REG(KSZ8851_REG_RXQCR) &= ~(RXQCR_RXDTTS | RXQCR_RXDBCTS | RXQCR_RXFCTS);
+         }
+         break;
+      case KSZ8851_REG_GRR:
+         if (value & GRR_GLOBAL_SOFT_RST) {
+            resetRegisters();
+         } else if (value & GRR_QMU_MODULE_SOFT_RST) {
+            resetQueues();
+         }
+         SIM_REG(KSZ8851_REG_GRR) = value;
+         break;
+      case KSZ8851_REG_RXFDPR:
+         bigEndian = (value & RXFDPR_EMS) != 0;
+         rxPointer = value & 0x07ff;
+         SIM_REG(KSZ8851_REG_RXFDPR) = value;
+         break;
+      case KSZ8851_REG_RXQCR:
+         writeRxqcr(value);
+         break;
+      case KSZ8851_REG_TXQCR:
+         SIM_REG(KSZ8851_REG_TXQCR) = value & ~TXQCR_METFE;
+         if (value & TXQCR_METFE) {
+            txEnqueueFrames();
+         }
+         txCheckSpaceAvailable();
+         break;
+      case KSZ8851_REG_RXFCTR:
+         SIM_REG(KSZ8851_REG_RXFCTR) = value & 0xff;
+         break;
+      case KSZ8851_REG_P1CR:
+         //Restart of auto negotiation: link comes up again
+         if (value & P1CR_RESTART_AN) {
+            SIM_REG(KSZ8851_REG_ISR) |= ISR_LCIS;
+            value &= ~P1CR_RESTART_AN;
+         }
+         SIM_REG(KSZ8851_REG_P1CR) = value;
+         break;
+      case KSZ8851_REG_CIDER:
+      case KSZ8851_REG_TXMIR:
+      case KSZ8851_REG_RXFHSR:
+      case KSZ8851_REG_RXFHBCR:
+      case KSZ8851_REG_P1SR:
+         //Read only
+         break;
+      default:
+         SIM_REG(address) = value;
+         break;
+   }
+   rxCheckThresholds();
+   updateInterruptLine();
+}
+
+static void updateInterruptLine(void)
+{
+   bool line = (SIM_REG(KSZ8851_REG_ISR) & SIM_REG(KSZ8851_REG_IER)) != 0;
+   if (line != interruptLine) {
+      interruptLine = line;
+      if (line) {
+         counters.interrupts++;
+      }
+      amigaHostSetInterruptLine(line);
+   }
+}
+
+// ------------------------------------- Port accesses ----------------------------------------------
+
+void ksz8851SimWriteCmd(uint16_t cmd)
+{
+   uint8_t lanes = cmd >> 12;
+   uint8_t lowWord  = bigEndian ? (lanes >> 2) : (lanes & 3); //Lanes of the word at the DWORD address
+   uint8_t highWord = bigEndian ? (lanes & 3)  : (lanes >> 2); //Lanes of the word at DWORD address + 2
+
+   counters.cmdWrites++;
+   busAccess(cmdWriteCost);
+
+   if (lowWord) {
+      cmdAddress  = cmd & 0xfc;
+      cmdLaneMask = ((lowWord & 1) ? 0x00ff : 0) | ((lowWord & 2) ? 0xff00 : 0);
+   } else {
+      cmdAddress  = (cmd & 0xfc) + 2;
+      cmdLaneMask = ((highWord & 1) ? 0x00ff : 0) | ((highWord & 2) ? 0xff00 : 0);
+   }
+   cmdArmed = true;
+}
+
+uint16_t ksz8851SimReadData(void)
+{
+   uint16_t value = 0;
+
+   counters.dataReads++;
+   busAccess(dataReadCost);
+
+   if (!cmdArmed && (SIM_REG(KSZ8851_REG_RXQCR) & RXQCR_SDA)) {
+      //RXQ read
+      if (rxCount) {
+         uint8_t b[2];
+         b[0] = rxStreamByte(rxPointer++);
+         b[1] = rxStreamByte(rxPointer++);
+         rxAccessed = true;
+         if (bigEndian) {
+            memcpy(&value, b, 2);
+         } else {
+            value = b[0] | (b[1] << 8);
+         }
+      }
+      return value;
+   }
+   cmdArmed = false;
+   value = readRegister(cmdAddress) & cmdLaneMask;
+   rxCheckThresholds();
+   return value;
+}
+
+void ksz8851SimWriteData(uint16_t value)
+{
+   counters.dataWrites++;
+   busAccess(dataWriteCost);
+
+   if (!cmdArmed && (SIM_REG(KSZ8851_REG_RXQCR) & RXQCR_SDA)) {
+      //TXQ write
+      uint8_t b[2];
+      if (bigEndian) {
+         memcpy(b, &value, 2);
+      } else {
+         b[0] = value & 0xff;
+         b[1] = value >> 8;
+      }
+      txWriteStream(b[0], b[1]);
+      return;
+   }
+   cmdArmed = false;
+   if (cmdLaneMask != 0xffff) {
+      value = (readRegister(cmdAddress) & ~cmdLaneMask) | (value & cmdLaneMask);
+   }
+   writeRegister(cmdAddress, value);
+}
+
+// ------------------------------------- Simulation control -----------------------------------------
+
+void ksz8851SimReset(void)
+{
+   resetRegisters();
+   interruptLine = false;
+   timeNs = 0;
+   memset(&counters, 0, sizeof(counters));
+}
+
+void ksz8851SimSetBusTiming(uint16_t cmdWriteCycles, uint16_t dataReadCycles, uint16_t dataWriteCycles)
+{
+   cmdWriteCost  = cmdWriteCycles;
+   dataReadCost  = dataReadCycles;
+   dataWriteCost = dataWriteCycles;
+}
+
+void ksz8851SimSetCpuClock(uint32_t hz)
+{
+   cpuHz = hz;
+}
+
+static bool rxInjectFrame(const uint8_t * frame, uint16_t length, uint16_t status)
+{
+   uint16_t tail;
+
+   if (length < 14 || length > SIM_MAX_FRAME - 4 || !rxAcceptFrame(frame)) {
+      counters.framesDropped++;
+      return false;
+   }
+
+   if (rxCount >= SIM_RXQ_FRAMES || rxBytesUsed + rxFootprint(length) > KSZ8851_SIM_RXQ_SIZE) {
+      //Receiver overrun
+      counters.framesDropped++;
+      SIM_REG(KSZ8851_REG_ISR) |= ISR_RXOIS;
+      updateInterruptLine();
+      return false;
+   }
+
+   tail = (rxHead + rxCount) % SIM_RXQ_FRAMES;
+   memcpy(rxq[tail].data, frame, length);
+   rxq[tail].length = length;
+   rxq[tail].status = status;
+   //Checksum verification: a wrong checksum makes the frame invalid
+   if (status & RXFHSR_RXFV) {
+      uint16_t errors = ipChecksums(rxq[tail].data, length, rxChecksumProtocols(), false);
+      if (errors) {
+         rxq[tail].status = errors;
+      }
+   }
+   rxCount++;
+   rxBytesUsed += rxFootprint(length);
+   counters.framesReceived++;
+
+   if (!rxTimerRunning) {
+      rxTimerRunning = true;
+      rxTimerStartNs = timeNs;
+   }
+   rxCheckThresholds();
+   return true;
+}
+
+bool ksz8851SimInjectFrame(const uint8_t * frame, uint16_t length)
+{
+   return rxInjectFrame(frame, length, RXFHSR_RXFV);
+}
+
+bool ksz8851SimInjectErrorFrame(const uint8_t * frame, uint16_t length, uint16_t status)
+{
+   return rxInjectFrame(frame, length, status & ~RXFHSR_RXFV);
+}
+
+void ksz8851SimSetWire(Ksz8851SimWireFunction function, void * userData, bool autoTransmit)
+{
+   wireFunction     = function;
+   wireUserData     = userData;
+   wireAutoTransmit = autoTransmit;
+}
+
+uint16_t ksz8851SimTransmit(uint16_t maxFrames)
+{
+   uint16_t sent = 0;
+
+   while (sent < maxFrames && txCount > 0 && txq[0].enqueued) {
+      SimTxFrame * frame = &txq[0];
+      if ((SIM_REG(KSZ8851_REG_TXCR) & TXCR_TXE) && wireFunction) {
+         ipChecksums(frame->data, frame->length, txChecksumProtocols(), true);
+         wireFunction(frame->data, frame->length, wireUserData);
+      }
+      if (frame->control & TX_CTRL_TXIC) {
+         SIM_REG(KSZ8851_REG_ISR) |= ISR_TXIS;
+      }
+      txBytesUsed -= txFootprint(frame->length);
+      memmove(&txq[0], &txq[1], (txCount - 1) * sizeof(SimTxFrame));
+      txCount--;
+      sent++;
+      counters.framesSent++;
+   }
+   txCheckSpaceAvailable();
+   updateInterruptLine();
+   return sent;
+}
+
+void ksz8851SimAdvanceTime(uint32_t microSeconds)
+{
+   timeNs += (uint64_t)microSeconds * 1000;
+   rxCheckThresholds();
+   amigaHostTimePassed(timeNs);
+}
+
+uint64_t ksz8851SimGetTime(void)
+{
+   return timeNs;
+}
+
+void ksz8851SimGetCounters(Ksz8851SimCounters * result)
+{
+   *result = counters;
+}
+
+void ksz8851SimResetCounters(void)
+{
+   memset(&counters, 0, sizeof(counters));
+}
+
+uint16_t ksz8851SimPendingRxFrames(void)
+{
+   return rxCount;
+}
+
+void ksz8851SimInterruptsDisabled(bool disabled)
+{
+   if (disabled) {
+      disabledSinceCycles = counters.busCycles;
+   } else if (counters.busCycles - disabledSinceCycles > counters.maxDisabledCycles) {
+      counters.maxDisabledCycles = counters.busCycles - disabledSinceCycles;
+   }
+}
+
+void ksz8851SimReportInterruptStorm(void)
+{
+   //The interrupt line stays asserted but no server handles it. On a real Amiga the machine hangs.
+   counters.framesDropped += 0;
+   SIM_REG(KSZ8851_REG_IER) = 0;
+   interruptLine = false;
+}
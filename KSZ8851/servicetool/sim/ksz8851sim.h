@@ -0,0 +1,127 @@
+/*
+ * KSZ8851 Amiga Network Driver - Host side chip simulator.
+ *
+ * Software model of the KSZ8851-16MLL as seen through the two 16 bit ports of the A1200+
+ * (command and data register). Used for the host build of libksz8851 ("make sim"): the port
+ * accesses of ksz8851.c are routed into this model which covers
+ *  - the register file incl. the byte enable logic (mirrored in big endian mode),
+ *  - the QMU RX queue (12 KB) and TX queue (6 KB) with RXFCTR/RXFHSR/RXFHBCR/TXMIR accounting,
+ *  - RX interrupt thresholds (frame count, byte count, duration timer),
+ *  - ISR/IER semantics (write 1 to clear) and the INT6 line,
+ *  - counting of bus accesses and bus cycles.
+ */
+
+#ifndef _KSZ8851_SIM_H
+#define _KSZ8851_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//The port accesses of the library go through the simulator
+#define KSZ8851_BUS_CMD_WRITE(cmd)     ksz8851SimWriteCmd(cmd)
+#define KSZ8851_BUS_DATA_READ()        ksz8851SimReadData()
+#define KSZ8851_BUS_DATA_WRITE(value)  ksz8851SimWriteData(value)
+
+//Size of the QMU queues of the chip
+#define KSZ8851_SIM_RXQ_SIZE    (12 * 1024)
+#define KSZ8851_SIM_TXQ_SIZE    (6 * 1024)
+
+/**
+ * Bus access counters. Take two snapshots (ksz8851SimGetCounters) around an operation to get its costs.
+ */
+typedef struct {
+   uint32_t cmdWrites;        //Writes to the command register
+   uint32_t dataReads;        //Reads from the data register
+   uint32_t dataWrites;       //Writes to the data register
+   uint32_t busCycles;        //CPU clocks spent on the bus (see ksz8851SimSetBusTiming)
+   uint32_t interrupts;       //Number of times the INT6 line was asserted
+   uint32_t framesReceived;   //Frames that went into the RXQ
+   uint32_t framesDropped;    //Frames that did not fit into the RXQ (overrun) or were filtered
+   uint32_t framesSent;       //Frames that left the TXQ
+   uint32_t maxDisabledCycles;//Longest period (bus cycles) with interrupts disabled (Disable())
+   uint32_t interruptStorms;  //INT6 stayed asserted but no interrupt server handled it (hangs a real Amiga)
+} Ksz8851SimCounters;
+
+/**
+ * Callback of the simulated wire: Called for every frame the chip transmits (without CRC).
+ */
+typedef void (*Ksz8851SimWireFunction)(const uint8_t * frame, uint16_t length, void * userData);
+
+/**
+ * Power on reset of the chip. After that the chip is in little endian mode and has the link up
+ * (100 MBit, full duplex).
+ */
+void ksz8851SimReset(void);
+
+/**
+ * Sets the costs of a single port access in CPU clocks (default: 8 for all accesses).
+ */
+void ksz8851SimSetBusTiming(uint16_t cmdWriteCycles, uint16_t dataReadCycles, uint16_t dataWriteCycles);
+
+/**
+ * Sets the CPU clock used to convert bus cycles into time (default: 14 MHz).
+ */
+void ksz8851SimSetCpuClock(uint32_t hz);
+
+/**
+ * Receives a frame from the wire (without CRC). The frame passes the address filter of the chip
+ * and is put into the RXQ if there is space left.
+ * @return true when the frame was put into the RXQ
+ */
+bool ksz8851SimInjectFrame(const uint8_t * frame, uint16_t length);
+
+/**
+ * Receives a frame with an error (e.g. RXFHSR_RXCE, a CRC error): The frame is put into the RXQ like a valid
+ * one, but its status has no RXFHSR_RXFV. The driver must release it.
+ * @return true when the frame was put into the RXQ
+ */
+bool ksz8851SimInjectErrorFrame(const uint8_t * frame, uint16_t length, uint16_t status);
+
+/**
+ * Fills in the IPv4 header checksum and the TCP, UDP or ICMP checksum of an IPv4 frame (like the chip does
+ * for transmitted frames with TXCR_TCGIP & co.).
+ */
+void ksz8851SimFillChecksums(uint8_t * frame, uint16_t length);
+
+/**
+ * Sets the function that gets the transmitted frames.
+ * @param autoTransmit true: frames leave the TXQ immediately when they are enqueued, false: only
+ *        when ksz8851SimTransmit() is called (to simulate a busy wire).
+ */
+void ksz8851SimSetWire(Ksz8851SimWireFunction function, void * userData, bool autoTransmit);
+
+/**
+ * Transmits up to "maxFrames" enqueued frames from the TXQ.
+ * @return number of transmitted frames
+ */
+uint16_t ksz8851SimTransmit(uint16_t maxFrames);
+
+/**
+ * Lets time pass (RX duration timer, timer.device requests of amigahost.c).
+ */
+void ksz8851SimAdvanceTime(uint32_t microSeconds);
+
+/**
+ * Simulated time in nanoseconds (bus cycles and ksz8851SimAdvanceTime).
+ */
+uint64_t ksz8851SimGetTime(void);
+
+void ksz8851SimGetCounters(Ksz8851SimCounters * counters);
+void ksz8851SimResetCounters(void);
+
+/**
+ * Number of frames waiting in the RXQ.
+ */
+uint16_t ksz8851SimPendingRxFrames(void);
+
+// Port accesses (see KSZ8851_BUS_CMD_WRITE, KSZ8851_BUS_DATA_READ, KSZ8851_BUS_DATA_WRITE)
+void     ksz8851SimWriteCmd(uint16_t cmd);
+uint16_t ksz8851SimReadData(void);
+void     ksz8851SimWriteData(uint16_t value);
+
+// Called by the exec replacement (amigahost.c)
+void ksz8851SimInterruptsDisabled(bool disabled);
+void ksz8851SimReportInterruptStorm(void);
+
+#endif
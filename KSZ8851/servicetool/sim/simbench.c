@@ -0,0 +1,763 @@
+/*
+ * KSZ8851 Amiga Network Driver - Host build.
+ *
+ * Benchmark and self check of libksz8851 against the chip simulator: Runs the receive, interrupt
+ * and send paths of the library with different frame sizes, checks every delivered frame and
+ * prints the bus accesses and bus cycles per frame. Exits with 1 if a frame got lost or corrupted.
+ *
+ * Usage: ksz8851sim [frames per test]
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ksz8851.h"
+#include "../fifo.h"
+
+static const MacAddr stationAddress = { .b = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 } };
+static const MacAddr peerAddress    = { .b = { 0x02, 0x66, 0x77, 0x88, 0x99, 0xaa } };
+
+static NetInterface * nif;
+
+//The frame that is expected next (RX: by the upper layer, TX: on the wire)
+static uint8_t  expectedFrame[ETH_MAX_FRAME_SIZE + 64];
+static uint16_t expectedLength;
+static uint32_t framesOk;
+static uint32_t framesBad;
+static uint32_t shadowErrors;
+//Bottom half mode: The ISR causes this software interrupt instead of signaling the task
+static struct Interrupt bottomHalf;
+static bool inBottomHalf;
+static uint32_t framesInBottomHalf;
+
+static void buildFrame(const MacAddr * dst, const MacAddr * src, uint16_t length, uint32_t seed)
+{
+   uint16_t i;
+   memcpy(expectedFrame, dst, 6);
+   memcpy(expectedFrame + 6, src, 6);
+   expectedFrame[12] = 0x08;
+   expectedFrame[13] = 0x00;
+   for (i = ETH_HEADER_SIZE; i < length; i++) {
+      expectedFrame[i] = (uint8_t)(seed * 31 + i * 7);
+   }
+   expectedLength = length;
+}
+
+static void checkFrame(const uint8_t * frame, uint16_t length)
+{
+   if (length == expectedLength && memcmp(frame, expectedFrame, length) == 0) {
+      framesOk++;
+      if (inBottomHalf) {
+         framesInBottomHalf++;
+      }
+   } else {
+      framesBad++;
+   }
+}
+
+static void onPacketReceived(NetInterface * interface, uint8_t * frame, uint16_t length)
+{
+   checkFrame(frame, length);
+}
+
+//Buffer of the upper layer for RX_DELIVER_DIRECT frames
+static uint8_t directFrame[ETH_MAX_FRAME_SIZE + 64] __attribute__((aligned(4)));
+
+//How onPacketHeader delivers the frames of the current run
+static RxDeliveryMode headerMode;
+
+static RxDeliveryMode onPacketHeader(NetInterface * interface, uint8_t * header, uint16_t length, uint8_t ** payloadBuffer)
+{
+   if (headerMode == RX_DELIVER_DISCARD) {
+      //Only the header can be checked
+      if (length == expectedLength && memcmp(header, expectedFrame, ETH_HEADER_SIZE) == 0) {
+         framesOk++;
+      } else {
+         framesBad++;
+      }
+      return RX_DELIVER_DISCARD;
+   }
+   memcpy(directFrame, header, ETH_HEADER_SIZE);
+   *payloadBuffer = directFrame + ETH_HEADER_SIZE;
+   return RX_DELIVER_DIRECT;
+}
+
+static void onPacketPayloadReceived(NetInterface * interface, uint8_t * header, uint16_t length)
+{
+   checkFrame(directFrame, length);
+}
+
+static void onWire(const uint8_t * frame, uint16_t length, void * userData)
+{
+   //Short frames are padded by the driver
+   checkFrame(frame, length < expectedLength ? length : expectedLength);
+}
+
+static void onBottomHalf(APTR data)
+{
+   inBottomHalf = true;
+   if (!nif->processEventsInterrupt(nif)) {
+      //A task uses the NIC: It has to do the job
+      Signal(FindTask(NULL), 1UL << nif->getUsedSignalNumber(nif));
+   }
+   inBottomHalf = false;
+}
+
+/**
+ * Calls the event handler as long as the task was signalled by the interrupt
+ */
+static void processSignals(void)
+{
+   while (amigaHostTakeSignals() & (1UL << nif->getUsedSignalNumber(nif))) {
+      nif->processEvents(nif);
+   }
+}
+
+/**
+ * Compares the register shadows of the library with the simulated chip (after every run)
+ */
+static void checkShadows(const char * operation)
+{
+   uint16_t errors;
+
+   ksz8851DisableInterrupts(nif);
+   errors = ksz8851CheckShadowRegs(nif);
+   ksz8851EnableInterrupts(nif, 0);
+   if (errors) {
+      printf("%s: %u register shadows differ from the chip!\n", operation, errors);
+      shadowErrors += errors;
+   }
+}
+
+#ifdef KSZ8851_PROFILE
+static void printProfile(char * format, ...)
+{
+   va_list args;
+   va_start(args, format);
+   vprintf(format, args);
+   va_end(args);
+}
+
+/**
+ * The profiler must have counted the same port accesses as the simulator
+ * @return true if the sums of all operations match
+ */
+static bool checkProfile(const Ksz8851SimCounters * counters)
+{
+   uint32_t cmd = 0, reads = 0, writes = 0;
+   unsigned i;
+
+   for (i = 0; i < KSZ8851_OP_COUNT; i++) {
+      cmd    += ksz8851Profile.ops[i].cmdWrites;
+      reads  += ksz8851Profile.ops[i].dataReads;
+      writes += ksz8851Profile.ops[i].dataWrites;
+   }
+   printf("\n");
+   ksz8851ProfileDump(printProfile);
+   if (cmd != counters->cmdWrites || reads != counters->dataReads || writes != counters->dataWrites) {
+      printf("profile differs from the simulator: cmd %u/%u, read %u/%u, write %u/%u\n", cmd, counters->cmdWrites,
+            reads, counters->dataReads, writes, counters->dataWrites);
+      return false;
+   }
+   return true;
+}
+#endif
+
+static void printResult(const char * operation, uint16_t length, uint32_t frames,
+      const Ksz8851SimCounters * before, const Ksz8851SimCounters * after)
+{
+   uint32_t cmd    = after->cmdWrites  - before->cmdWrites;
+   uint32_t reads  = after->dataReads  - before->dataReads;
+   uint32_t writes = after->dataWrites - before->dataWrites;
+   uint32_t cycles = after->busCycles  - before->busCycles;
+   uint32_t ints   = after->interrupts - before->interrupts;
+
+   printf("%-22s %5u %7u %9.1f %9.1f %9.1f %10.1f %10.1f %7.2f\n", operation, length, frames,
+         (double)cmd / frames, (double)reads / frames, (double)writes / frames,
+         (double)(cmd + reads + writes) / frames, (double)cycles / frames, (double)ints / frames);
+   checkShadows(operation);
+}
+
+/**
+ * @param mode RX_DELIVER_COPY: without onPacketHeader (as before the header peek), else the result of onPacketHeader
+ */
+static void benchReceive(uint16_t length, uint32_t frames, uint16_t burst, RxDeliveryMode mode)
+{
+   static const char * const modeNames[] = { "", " dma", " drop" };
+   Ksz8851SimCounters before, after;
+   uint32_t i, j;
+   char name[32];
+
+   headerMode = mode;
+   nif->onPacketHeader = mode != RX_DELIVER_COPY ? onPacketHeader : NULL;
+   ksz8851SimGetCounters(&before);
+   for (i = 0; i < frames; i += burst) {
+      for (j = 0; j < burst; j++) {
+         buildFrame(&stationAddress, &peerAddress, length, 0);
+         ksz8851SimInjectFrame(expectedFrame, length);
+      }
+      //Time on the wire (100 MBit, incl. preamble, CRC and inter frame gap)
+      ksz8851SimAdvanceTime((length + 24) * 8 * burst / 100);
+      processSignals();
+   }
+   //Frames below the coalescing thresholds are delivered by the RX duration timer
+   while (ksz8851SimPendingRxFrames()) {
+      ksz8851SimAdvanceTime(100);
+      processSignals();
+   }
+   ksz8851SimGetCounters(&after);
+   snprintf(name, sizeof(name), burst > 1 ? "receive%s%s x%u" : "receive%s%s", modeNames[mode],
+         nif->bottomHalf ? " softint" : nif->rxCoalesceFrames <= 1 ? "" : nif->rxCoalesceAdaptive ? " adaptive" : " coalesced",
+         burst);
+   printResult(name, length, frames, &before, &after);
+}
+
+/**
+ * RX polling under load: A burst of "budget" frames arrives every poll interval (plus slack for the bus cycles
+ * of the event handler). The first burst switches to polling, the poll timer reads the following bursts with
+ * the RX interrupt disabled. The RX interrupt is enabled again when the RXQ is empty.
+ */
+static void benchReceivePolling(uint16_t length, uint32_t frames)
+{
+   Ksz8851Context * context = (Ksz8851Context *)nif->nicContext;
+   uint16_t burst = nif->rxPollBudget;
+   Ksz8851SimCounters before, after;
+   uint32_t i, j;
+
+   headerMode = RX_DELIVER_COPY;
+   nif->onPacketHeader = NULL;
+   ksz8851SimGetCounters(&before);
+   for (i = 0; i < frames; i += burst) {
+      for (j = 0; j < burst; j++) {
+         buildFrame(&stationAddress, &peerAddress, length, 0);
+         ksz8851SimInjectFrame(expectedFrame, length);
+      }
+      ksz8851SimAdvanceTime(nif->rxPollInterval + nif->rxPollInterval / 2);
+      processSignals();
+   }
+   //The last poll finds the RXQ empty and enables the RX interrupt again
+   while (ksz8851SimPendingRxFrames() || context->rxPolling) {
+      ksz8851SimAdvanceTime(nif->rxPollInterval);
+      processSignals();
+   }
+   ksz8851SimGetCounters(&after);
+   printResult("receive polling", length, frames, &before, &after);
+}
+
+//Frames of the current batch that did not fit into the TXQ yet (sent by onTxSpaceAvailable)
+/**
+ * Bursts of 4 frames, the last one of every burst is an error frame (CRC error) the library must release
+ * @param frames multiple of 4
+ */
+static void benchReceiveErrors(uint16_t length, uint32_t frames)
+{
+   Ksz8851SimCounters before, after;
+   uint32_t i, j;
+   uint32_t badFrames = nif->rxBadFrames;
+
+   nif->onPacketHeader = NULL;
+   ksz8851SimGetCounters(&before);
+   for (i = 0; i < frames; i += 4) {
+      buildFrame(&stationAddress, &peerAddress, length, 0);
+      for (j = 0; j < 4; j++) {
+         if (j == 3) {
+            ksz8851SimInjectErrorFrame(expectedFrame, length, RXFHSR_RXCE);
+         } else {
+            ksz8851SimInjectFrame(expectedFrame, length);
+         }
+      }
+      ksz8851SimAdvanceTime((length + 24) * 8 * 4 / 100);
+      processSignals();
+   }
+   while (ksz8851SimPendingRxFrames()) {
+      ksz8851SimAdvanceTime(100);
+      processSignals();
+   }
+   ksz8851SimGetCounters(&after);
+   printResult("receive errors x4", length, frames, &before, &after);
+   if (nif->rxBadFrames - badFrames != frames / 4) {
+      printf("bad frames: %u, expected %u\n", nif->rxBadFrames - badFrames, frames / 4);
+      framesBad++;
+   }
+}
+
+//Multicast runs: the only group of the upper layer, frames of other groups are counted and dropped
+static MacAddr multicastGroup;
+static uint32_t multicastDropped;
+
+/**
+ * Exact check of the upper layer: the hash filter of the NIC also passes other groups with the same hash
+ */
+static RxDeliveryMode onMulticastHeader(NetInterface * interface, uint8_t * header, uint16_t length, uint8_t ** payloadBuffer)
+{
+   if (memcmp(header, &multicastGroup, 6) != 0) {
+      multicastDropped++;
+      return RX_DELIVER_DISCARD;
+   }
+   memcpy(directFrame, header, ETH_HEADER_SIZE);
+   *payloadBuffer = directFrame + ETH_HEADER_SIZE;
+   return RX_DELIVER_DIRECT;
+}
+
+/**
+ * Bursts of 4 multicast frames: 2 of the group, 1 of a group with the same hash (passes the NIC), 1 of a group
+ * with another hash (dropped by the NIC unless all multicast frames are received)
+ * @param allMulticast more groups than the hash filter takes: the NIC receives all multicast frames
+ * @param frames multiple of 4
+ */
+static void benchReceiveMulticast(uint16_t length, uint32_t frames, bool allMulticast)
+{
+   static uint8_t otherFrame[ETH_MAX_FRAME_SIZE];
+   MacFilterEntry filter = { .refCount = 1 };
+   MacAddr collision, other;
+   Ksz8851SimCounters before, after;
+   uint32_t expectedDropped = allMulticast ? frames / 2 : frames / 4;
+   uint32_t i;
+
+   //IPv4 multicast 224.0.0.251 and two other groups: same hash and another one
+   memcpy(multicastGroup.b, "\x01\x00\x5e\x00\x00\xfb", 6);
+   collision = other = multicastGroup;
+   do {
+      collision.b[5]++;
+   } while (ksz8851MulticastHash(&collision) != ksz8851MulticastHash(&multicastGroup));
+   do {
+      other.b[4]++;
+   } while (ksz8851MulticastHash(&other) == ksz8851MulticastHash(&multicastGroup));
+
+   filter.addr = multicastGroup;
+   nif->setMulticastFilter(nif, allMulticast ? NULL : &filter, 1);
+   nif->onPacketHeader = onMulticastHeader;
+   multicastDropped = 0;
+   buildFrame(&multicastGroup, &peerAddress, length, 0);
+   memcpy(otherFrame, expectedFrame, length);
+
+   ksz8851SimGetCounters(&before);
+   for (i = 0; i < frames; i += 4) {
+      ksz8851SimInjectFrame(expectedFrame, length);
+      memcpy(otherFrame, &collision, 6);
+      ksz8851SimInjectFrame(otherFrame, length);
+      memcpy(otherFrame, &other, 6);
+      ksz8851SimInjectFrame(otherFrame, length);
+      ksz8851SimInjectFrame(expectedFrame, length);
+      ksz8851SimAdvanceTime((length + 24) * 8 * 4 / 100);
+      processSignals();
+   }
+   while (ksz8851SimPendingRxFrames()) {
+      ksz8851SimAdvanceTime(100);
+      processSignals();
+   }
+   ksz8851SimGetCounters(&after);
+   printResult(allMulticast ? "receive allmulti x4" : "receive multicast x4", length, frames, &before, &after);
+
+   if (multicastDropped != expectedDropped) {
+      printf("multicast filter: %u frames of other groups dropped, expected %u\n", multicastDropped, expectedDropped);
+      framesBad++;
+   }
+   nif->setMulticastFilter(nif, &filter, 0);
+}
+
+/**
+ * IPv4 frame with an ICMP (1), TCP (6) or UDP (17) payload, the checksums are zero
+ */
+static void buildIpFrame(const MacAddr * dst, const MacAddr * src, uint16_t length, uint8_t protocol, uint32_t seed)
+{
+   uint8_t * ip = expectedFrame + ETH_HEADER_SIZE;
+
+   buildFrame(dst, src, length, seed);
+   memset(ip, 0, 28);
+   ip[0] = 0x45;
+   ip[2] = (length - ETH_HEADER_SIZE) >> 8;
+   ip[3] = (length - ETH_HEADER_SIZE);
+   ip[8] = 64;
+   ip[9] = protocol;
+   memcpy(ip + 12, "\xc0\xa8\x00\x02\xc0\xa8\x00\x01", 8);
+   if (protocol == 17) {
+      ip[24] = (length - ETH_HEADER_SIZE - 20) >> 8;
+      ip[25] = (length - ETH_HEADER_SIZE - 20);
+   }
+}
+
+/**
+ * Checksum offload. Receive: bursts of 4 frames, the 2nd has a wrong IP header checksum, the 4th a wrong
+ * ICMP, TCP or UDP checksum (the NIC drops them). Send: the NIC fills in the checksums.
+ * @param frames multiple of 4
+ */
+static void benchChecksumOffload(uint16_t length, uint32_t frames)
+{
+   static const uint8_t protocols[] = { 17, 6, 1 };
+   static const NetChecksumProtocol checksums[] = { NET_CHECKSUM_UDP, NET_CHECKSUM_TCP, NET_CHECKSUM_ICMP };
+   static uint8_t otherFrame[ETH_MAX_FRAME_SIZE];
+   uint32_t errors[NET_CHECKSUM_COUNT] = { 0 };
+   Ksz8851SimCounters before, after;
+   uint32_t i;
+   uint16_t j;
+
+   nif->checksumOffload = true;
+   nif->updateChecksumOffload(nif);
+   nif->onPacketHeader = NULL;
+   for (j = 0; j < NET_CHECKSUM_COUNT; j++) {
+      errors[j] = nif->rxChecksumErrors[j];
+   }
+
+   ksz8851SimGetCounters(&before);
+   for (i = 0; i < frames; i += 4) {
+      buildIpFrame(&stationAddress, &peerAddress, length, protocols[i / 4 % 3], 0);
+      ksz8851SimFillChecksums(expectedFrame, length);
+      ksz8851SimInjectFrame(expectedFrame, length);
+      memcpy(otherFrame, expectedFrame, length);
+      otherFrame[ETH_HEADER_SIZE + 10] ^= 0x01;
+      ksz8851SimInjectFrame(otherFrame, length);
+      errors[NET_CHECKSUM_IP]++;
+      ksz8851SimInjectFrame(expectedFrame, length);
+      memcpy(otherFrame, expectedFrame, length);
+      otherFrame[length - 1] ^= 0xff;
+      ksz8851SimInjectFrame(otherFrame, length);
+      errors[checksums[i / 4 % 3]]++;
+      ksz8851SimAdvanceTime((length + 24) * 8 * 4 / 100);
+      processSignals();
+   }
+   while (ksz8851SimPendingRxFrames()) {
+      ksz8851SimAdvanceTime(100);
+      processSignals();
+   }
+   ksz8851SimGetCounters(&after);
+   printResult("receive checksum x4", length, frames, &before, &after);
+   for (j = 0; j < NET_CHECKSUM_COUNT; j++) {
+      if (nif->rxChecksumErrors[j] != errors[j]) {
+         printf("checksum errors of protocol %u: %u, expected %u\n", j, nif->rxChecksumErrors[j], errors[j]);
+         framesBad++;
+      }
+   }
+
+   ksz8851SimGetCounters(&before);
+   for (i = 0; i < frames; i++) {
+      buildIpFrame(&peerAddress, &stationAddress, length, protocols[i % 3], i);
+      memcpy(otherFrame, expectedFrame, length);
+      ksz8851SimFillChecksums(expectedFrame, length);
+      if (nif->sendPacket(nif, otherFrame, length) != NO_ERROR) {
+         framesBad++;
+      }
+      processSignals();
+   }
+   ksz8851SimGetCounters(&after);
+   printResult("send checksum", length, frames, &before, &after);
+
+   nif->checksumOffload = false;
+   nif->updateChecksumOffload(nif);
+}
+
+static NetTxFrame * pendingFrames;
+static uint16_t pendingCount;
+
+static void sendPending(void)
+{
+   uint16_t sent = nif->sendPackets(nif, pendingFrames, pendingCount);
+   pendingFrames += sent;
+   pendingCount  -= sent;
+}
+
+static void onTxSpaceAvailable(NetInterface * interface)
+{
+   sendPending();
+}
+
+/**
+ * @param burst 1: sendPacketCooked per frame, else batches of "burst" frames (sendPackets)
+ * @param busyWire false: frames leave the TXQ when enqueued, true: one frame per wire time (the TXQ fills up,
+ *        the rest of a batch is sent by the TX space available interrupt)
+ */
+static void benchSend(uint16_t length, uint32_t frames, uint16_t burst, bool busyWire)
+{
+   static uint8_t payload[ETH_MAX_FRAME_SIZE + 64];
+   NetTxFrame batch[16];
+   NetTxSegment segments[2];
+   Ksz8851SimCounters before, after;
+   uint32_t i;
+   uint16_t j;
+   uint16_t idle;
+   char name[32];
+
+   ksz8851SimSetWire(onWire, NULL, !busyWire);
+   ksz8851SimGetCounters(&before);
+   for (i = 0; i < frames; i += burst) {
+      buildFrame(&peerAddress, &stationAddress, length, i);
+      memcpy(payload, expectedFrame + ETH_HEADER_SIZE, length - ETH_HEADER_SIZE);
+      if (burst == 1) {
+         if (nif->sendPacketCooked(nif, (MacAddr *)&peerAddress, (MacAddr *)&stationAddress, 0x0800,
+               payload, length - ETH_HEADER_SIZE) != NO_ERROR) {
+            framesBad++;
+         }
+         processSignals();
+         continue;
+      }
+      //Ethernet header and payload (all frames of a batch are the same)
+      segments[0].data   = expectedFrame;
+      segments[0].length = ETH_HEADER_SIZE;
+      segments[1].data   = payload;
+      segments[1].length = length - ETH_HEADER_SIZE;
+      for (j = 0; j < burst; j++) {
+         batch[j].segments     = segments;
+         batch[j].segmentCount = 2;
+      }
+      //The TX FIFO (6 KByte) holds less than a batch of big frames
+      pendingFrames = batch;
+      pendingCount  = burst;
+      sendPending();
+      for (idle = 0; pendingCount > 0 && idle < 100; idle++) {
+         if (busyWire) {
+            ksz8851SimTransmit(1);
+            ksz8851SimAdvanceTime((length + 24) * 8 / 100);
+         }
+         processSignals();
+      }
+      if (pendingCount > 0) {
+         //No TX space interrupt
+         framesBad += pendingCount;
+      }
+      //Let the wire catch up before the next batch (frames are checked against the current one)
+      while (ksz8851SimTransmit(64)) {
+         processSignals();
+      }
+      processSignals();
+   }
+   ksz8851SimGetCounters(&after);
+   ksz8851SimSetWire(onWire, NULL, true);
+   snprintf(name, sizeof(name), burst > 1 ? "send%s%s x%u" : "send%s%s", nif->txAutoEnqueue ? " auto" : "",
+         busyWire ? " busy" : "", burst);
+   printResult(name, length, frames, &before, &after);
+}
+
+/**
+ * Frames scattered over segments with odd lengths (sendPacketV)
+ */
+static void benchSendV(uint16_t length, uint32_t frames)
+{
+   NetTxSegment segments[4];
+   Ksz8851SimCounters before, after;
+   uint32_t i;
+
+   ksz8851SimGetCounters(&before);
+   for (i = 0; i < frames; i++) {
+      buildFrame(&peerAddress, &stationAddress, length, i);
+      segments[0].data   = expectedFrame;
+      segments[0].length = 7;
+      segments[1].data   = expectedFrame + 7;
+      segments[1].length = 8;
+      segments[2].data   = expectedFrame + 15;
+      segments[2].length = 13;
+      segments[3].data   = expectedFrame + 28;
+      segments[3].length = length - 28;
+      if (nif->sendPacketV(nif, segments, 4) != NO_ERROR) {
+         framesBad++;
+      }
+      processSignals();
+   }
+   ksz8851SimGetCounters(&after);
+   printResult("send scattered", length, frames, &before, &after);
+}
+
+/**
+ * Switches the endian mode of the chip and the library (like the probe of the library does)
+ */
+static void setEndianMode(bool bigEndian)
+{
+   Ksz8851Context * context = (Ksz8851Context *)nif->nicContext;
+   uint16_t rxfdpr;
+
+   ksz8851DisableInterrupts(nif);
+   //The EMS bit can't be read back: the library takes it from the shadow
+   rxfdpr = context->rxfdpr & ~RXFDPR_EMS;
+   ksz8851WriteShadowReg(nif, KSZ8851_REG_RXFDPR, bigEndian ? rxfdpr | RXFDPR_EMS : rxfdpr);
+   context->isInBigEndianMode = bigEndian;
+   ksz8851EnableInterrupts(nif, 0);
+}
+
+//Frame lengths of the FIFO kernel check: every rest of a few blocks of the unrolled kernels
+#define KERNEL_CHECK_MIN_LENGTH ETH_MIN_FRAME_SIZE
+#define KERNEL_CHECK_MAX_LENGTH (ETH_MIN_FRAME_SIZE + 4 * 2 * FIFO_BLOCK_WORDS)
+
+/**
+ * Receives and sends frames of all lengths in little and big endian mode: The FIFO kernels (fifo.c) against
+ * the byte stream of the simulator.
+ * @return number of checked frames
+ */
+static uint32_t checkFifoKernels(void)
+{
+   uint32_t frames = 0;
+   uint16_t length;
+   int mode;
+
+#ifdef KSZ8851_FIXED_BIG_ENDIAN
+   //The library supports the big endian mode only
+   mode = 1;
+#else
+   mode = 0;
+#endif
+   for (; mode < 2; mode++) {
+      setEndianMode(mode != 0);
+      for (length = KERNEL_CHECK_MIN_LENGTH; length <= KERNEL_CHECK_MAX_LENGTH; length++) {
+         buildFrame(&stationAddress, &peerAddress, length, length);
+         ksz8851SimInjectFrame(expectedFrame, length);
+         ksz8851SimAdvanceTime((length + 24) * 8 / 100);
+         processSignals();
+
+         buildFrame(&peerAddress, &stationAddress, length, length);
+         if (nif->sendPacket(nif, expectedFrame, length) != NO_ERROR) {
+            framesBad++;
+         }
+         processSignals();
+         frames += 2;
+      }
+   }
+   printf("fifo kernels %s: %u frames checked\n", ksz8851FifoKernelName, frames);
+   return frames;
+}
+
+int main(int argc, char * argv[])
+{
+   static const uint16_t sizes[] = { 60, 590, 1514 };
+   uint32_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000;
+   uint32_t expected;
+   uint32_t kernelFrames;
+   Ksz8851SimCounters counters;
+   unsigned i;
+
+   if (frames == 0) {
+      frames = 1;
+   }
+
+   ksz8851SimReset();
+   ksz8851SimSetWire(onWire, NULL, true);
+
+   nif = initModule();
+   nif->onPacketReceived = onPacketReceived;
+   nif->onPacketPayloadReceived = onPacketPayloadReceived;
+   nif->txSpaceAvailableFunction = onTxSpaceAvailable;
+   if (nif->probe(nif) != NO_ERROR || nif->init(nif) != NO_ERROR) {
+      printf("KSZ8851 not found!\n");
+      return 1;
+   }
+   nif->setNetworkAddress(nif, (MacAddr *)&stationAddress);
+   nif->online(nif);
+   processSignals();
+
+   kernelFrames = checkFifoKernels();
+
+   printf("%-22s %5s %7s %9s %9s %9s %10s %10s %7s\n", "operation", "size", "frames",
+         "cmd/f", "read/f", "write/f", "access/f", "cycles/f", "int/f");
+
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceive(sizes[i], frames, 1, RX_DELIVER_COPY);
+   }
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceive(sizes[i], frames - frames % 8 + 8, 8, RX_DELIVER_COPY);
+   }
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceive(sizes[i], frames, 1, RX_DELIVER_DIRECT);
+   }
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceive(sizes[i], frames - frames % 8 + 8, 8, RX_DELIVER_DISCARD);
+   }
+
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceiveErrors(sizes[i], frames - frames % 4 + 4);
+   }
+   //Checksum offload: frames with a wrong checksum are dropped, the checksums of sent frames are filled in
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchChecksumOffload(sizes[i], frames - frames % 4 + 4);
+   }
+   //Multicast: hash filter (exact check above it) and all multicast frames
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceiveMulticast(sizes[i], frames - frames % 4 + 4, false);
+      benchReceiveMulticast(sizes[i], frames - frames % 4 + 4, true);
+   }
+
+   //RX interrupt coalescing (back to back frames): fixed 8 frames per interrupt, then adaptive (up to 8)
+   nif->rxCoalesceFrames = 8;
+   nif->rxCoalesceTime   = 200;
+   nif->updateRxCoalescing(nif);
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceive(sizes[i], frames, 1, RX_DELIVER_COPY);
+   }
+   //Adaptive: the task gets the CPU only after 4 frames (busy machine), so the frames pile up
+   nif->rxCoalesceAdaptive = true;
+   nif->updateRxCoalescing(nif);
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceive(sizes[i], frames - frames % 4 + 4, 4, RX_DELIVER_COPY);
+   }
+   nif->rxCoalesceFrames   = 0;
+   nif->rxCoalesceAdaptive = false;
+   nif->updateRxCoalescing(nif);
+
+   //Bottom half: The software interrupt delivers the frames right after the interrupt (not the task)
+   bottomHalf.is_Node.ln_Type = NT_INTERRUPT;
+   bottomHalf.is_Data = nif;
+   bottomHalf.is_Code = (void (*)(void))onBottomHalf;
+   nif->bottomHalf = &bottomHalf;
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceive(sizes[i], frames, 1, RX_DELIVER_COPY);
+   }
+   nif->bottomHalf = NULL;
+
+   //RX polling: 8 frames per poll, every 100 microseconds (the poll timer is opened when going online)
+   nif->offline(nif);
+   nif->rxPollBudget   = 8;
+   nif->rxPollInterval = 100;
+   nif->online(nif);
+   processSignals();
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchReceivePolling(sizes[i], frames - frames % 8 + 8);
+   }
+   nif->offline(nif);
+   nif->rxPollBudget = 0;
+   nif->online(nif);
+   processSignals();
+   //Without a budget timer.device isn't opened
+   if (((Ksz8851Context *)nif->nicContext)->pollTimerOpen) {
+      printf("poll timer opened without a poll budget!\n");
+      return 1;
+   }
+
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchSend(sizes[i], frames, 1, false);
+   }
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchSend(sizes[i], frames - frames % 8 + 8, 8, false);
+   }
+   //Batches queued by the NIC when the TXQ access ends
+   nif->txAutoEnqueue = true;
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchSend(sizes[i], frames - frames % 8 + 8, 8, false);
+   }
+   nif->txAutoEnqueue = false;
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchSendV(sizes[i], frames);
+   }
+   //Slow wire: the frames that don't fit wait for the TX space available interrupt
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+      benchSend(sizes[i], frames - frames % 8 + 8, 8, true);
+   }
+
+   nif->offline(nif);
+
+   ksz8851SimGetCounters(&counters);
+   expected = kernelFrames + (frames + (frames - frames % 8 + 8) + frames + frames + (frames - frames % 8 + 8) + (frames - frames % 4 + 4) * 3 / 4 + (frames - frames % 4 + 4) * 5 / 2 + frames + (frames - frames % 4 + 4) + frames + (frames - frames % 8 + 8) + 3 * (frames - frames % 8 + 8) + frames) * (sizeof(sizes) / sizeof(sizes[0]));
+   printf("\nmax. cycles with interrupts disabled: %u, interrupts: %u, interrupt storms: %u\n",
+         counters.maxDisabledCycles, counters.interrupts, counters.interruptStorms);
+   printf("frames delivered by the software interrupt: %u\n", framesInBottomHalf);
+   printf("register shadow errors: %u\n", shadowErrors);
+   printf("RX polls: %u, switches to polling: %u\n", nif->rxPolls, nif->rxPollSwitches);
+#ifdef KSZ8851_PROFILE
+   if (!checkProfile(&counters)) {
+      return 1;
+   }
+#endif
+   printf("frames ok: %u, bad: %u, lost: %u\n", framesOk, framesBad,
+         framesOk + framesBad < expected ? (unsigned)(expected - framesOk - framesBad) : 0);
+
+   return (framesBad == 0 && framesOk == expected && counters.interruptStorms == 0 && shadowErrors == 0
+         && framesInBottomHalf == frames * (sizeof(sizes) / sizeof(sizes[0]))
+         && nif->rxPolls > 0 && nif->rxPollSwitches > 0) ? 0 : 1;
+}